@@ -3,19 +3,34 @@
 #include "Converter.h"
 #include <sstream>
 
-BaseEffect::BaseEffect(ID3D11Device* pDevice, const std::string& assetFile)
-	: m_pEffect{ BaseEffect::LoadEffect(pDevice, assetFile) }
+BaseEffect::BaseEffect(ID3D11Device* pDevice, const std::string& assetFile, const D3D_SHADER_MACRO* pDefines)
+	: m_pEffect{ BaseEffect::LoadEffect(pDevice, assetFile, pDefines) }
 {
 	SetTechnique();
 
-	m_pMatWorldViewProjVariable = m_pEffect->GetVariableByName("gWorldViewProj")->AsMatrix();
-	if (!m_pMatWorldViewProjVariable->IsValid())
-		std::cout << "m_pMatWorldViewProjVariable not valid!" << '\n';
+	m_pMatViewProjVariable = m_pEffect->GetVariableByName("gViewProj")->AsMatrix();
+	if (!m_pMatViewProjVariable->IsValid())
+		std::cout << "m_pMatViewProjVariable not valid!" << '\n';
+
+	m_pPositionScaleVariable = m_pEffect->GetVariableByName("gPositionScale")->AsVector();
+	if (!m_pPositionScaleVariable->IsValid())
+		std::cout << "m_pPositionScaleVariable not valid!" << '\n';
+
+	m_pPositionOffsetVariable = m_pEffect->GetVariableByName("gPositionOffset")->AsVector();
+	if (!m_pPositionOffsetVariable->IsValid())
+		std::cout << "m_pPositionOffsetVariable not valid!" << '\n';
+
+	m_pUVDecodeVariable = m_pEffect->GetVariableByName("gUVDecode")->AsVector();
+	if (!m_pUVDecodeVariable->IsValid())
+		std::cout << "m_pUVDecodeVariable not valid!" << '\n';
 }
 
 BaseEffect::~BaseEffect()
 {
-	m_pMatWorldViewProjVariable->Release();
+	m_pUVDecodeVariable->Release();
+	m_pPositionOffsetVariable->Release();
+	m_pPositionScaleVariable->Release();
+	m_pMatViewProjVariable->Release();
 	m_pTechnique->Release();
 	m_pEffect->Release();
 }
@@ -30,10 +45,17 @@ ID3DX11EffectTechnique* BaseEffect::GetTechnique() const
 	return m_pTechnique;
 }
 
-void BaseEffect::SetWorldViewProjMatrix(const Elite::FMatrix4& worldViewProj)
+void BaseEffect::SetViewProjMatrix(const Elite::FMatrix4& viewProj)
 {
-	const float* firstElement{ worldViewProj.data[0] };
-	m_pMatWorldViewProjVariable->SetMatrix(firstElement);
+	const float* firstElement{ viewProj.data[0] };
+	m_pMatViewProjVariable->SetMatrix(firstElement);
+}
+
+void BaseEffect::SetVertexDecode(const Elite::FVector4& positionScale, const Elite::FVector4& positionOffset, const Elite::FVector4& uvDecode)
+{
+	m_pPositionScaleVariable->SetFloatVector(positionScale.data);
+	m_pPositionOffsetVariable->SetFloatVector(positionOffset.data);
+	m_pUVDecodeVariable->SetFloatVector(uvDecode.data);
 }
 
 const BaseEffect::EffectSamplerState& BaseEffect::ChangeSamplerState()
@@ -66,7 +88,7 @@ void BaseEffect::SetCullMode(const EffectCullMode& cullmode)
 	SetTechnique();
 }
 
-ID3DX11Effect* BaseEffect::LoadEffect(ID3D11Device* pDevice, const std::string& assetFile)
+ID3DX11Effect* BaseEffect::LoadEffect(ID3D11Device* pDevice, const std::string& assetFile, const D3D_SHADER_MACRO* pDefines)
 {
 	HRESULT result = S_OK;
 	ID3D10Blob* pErrorBlob = nullptr;
@@ -79,7 +101,7 @@ ID3DX11Effect* BaseEffect::LoadEffect(ID3D11Device* pDevice, const std::string&
 #endif
 	std::wstring wAssetFile{ Converter::ConvertStringToWString(assetFile) };
 	result = D3DX11CompileEffectFromFile(wAssetFile.c_str(),
-		nullptr,
+		pDefines,
 		nullptr,
 		shaderFlags,
 		0,
@@ -2,7 +2,7 @@
 class BaseEffect
 {
 public:
-	BaseEffect(ID3D11Device* pDevice, const std::string& assetFile);
+	BaseEffect(ID3D11Device* pDevice, const std::string& assetFile, const D3D_SHADER_MACRO* pDefines = nullptr);
 	virtual ~BaseEffect();
 	BaseEffect(const BaseEffect&) = delete;
 	BaseEffect& operator=(const BaseEffect&) = delete;
@@ -28,13 +28,16 @@ public:
 	const ID3DX11Effect* GetEffect() const;
 	ID3DX11EffectTechnique* GetTechnique() const;
 
-	void SetWorldViewProjMatrix(const Elite::FMatrix4& worldViewProj);
+	//The world matrix comes with every instance, see Mesh::Instance
+	void SetViewProjMatrix(const Elite::FMatrix4& viewProj);
+	//Scale and offset that turn quantized positions and uvs back into their original range, only used with COMPACT_VERTEX
+	void SetVertexDecode(const Elite::FVector4& positionScale, const Elite::FVector4& positionOffset, const Elite::FVector4& uvDecode);
 	const EffectSamplerState& ChangeSamplerState();
 	const EffectCullMode& ChangeCullMode();
 	const EffectCullMode& GetCullMode() const;
 	void SetCullMode(const EffectCullMode& cullmode);
 protected:
-	static ID3DX11Effect* LoadEffect(ID3D11Device* pDevice, const std::string& assetFile);
+	static ID3DX11Effect* LoadEffect(ID3D11Device* pDevice, const std::string& assetFile, const D3D_SHADER_MACRO* pDefines);
 
 	EffectSamplerState m_Technique{ EffectSamplerState::Point };
 	EffectCullMode m_CullMode{ EffectCullMode::Back };
@@ -44,6 +47,9 @@ protected:
 	ID3DX11Effect* m_pEffect = nullptr;
 	ID3DX11EffectTechnique* m_pTechnique = nullptr;
 
-	ID3DX11EffectMatrixVariable* m_pMatWorldViewProjVariable = nullptr;
+	ID3DX11EffectMatrixVariable* m_pMatViewProjVariable = nullptr;
+	ID3DX11EffectVectorVariable* m_pPositionScaleVariable = nullptr;
+	ID3DX11EffectVectorVariable* m_pPositionOffsetVariable = nullptr;
+	ID3DX11EffectVectorVariable* m_pUVDecodeVariable = nullptr;
 };
 
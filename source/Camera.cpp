@@ -38,6 +38,7 @@ void Camera::SetScreen(float width, float height)
 	m_ScreenWidth = width;
 	m_ScreenHeight = height;
 	m_AspectRatio = width / height;
+	m_IsDirty = true;
 }
 
 const Elite::FMatrix4& Camera::GetONB() const
@@ -61,6 +62,9 @@ void Camera::Move(float elapsedSec)
 	float FOVAngleSpeed{ 3.f };
 	float cameraAngleSpeed{ 1/100.f };
 	const Uint8* pKeysStates = SDL_GetKeyboardState(nullptr);
+	const Elite::FPoint3 oldPosition{ m_Position };
+	const float oldAngleX{ m_AngleX };
+	const float oldAngleY{ m_AngleY };
 	
 
 	//Movement
@@ -143,6 +147,7 @@ void Camera::Move(float elapsedSec)
 		m_MousePos.data[1] = 0.f;
 	}
 
+	if (m_Position.x != oldPosition.x || m_Position.y != oldPosition.y || m_Position.z != oldPosition.z || m_AngleX != oldAngleX || m_AngleY != oldAngleY) m_IsDirty = true;
 	UpdateONB();
 }
 
@@ -158,7 +163,17 @@ float Camera::GetScreenHeight() const
 
 bool Camera::FrustumCull(float z) const
 {
-	return z < m_NearPlaneZ || z > m_FarPlaneZ;
+	return z < m_NearPlaneZ || z > GetFarPlane();
+}
+
+float Camera::GetNearPlane() const
+{
+	return m_NearPlaneZ;
+}
+
+float Camera::GetFarPlane() const
+{
+	return m_IsReverseZ ? FLT_MAX : m_FarPlaneZ;
 }
 
 void Camera::SetHandedNess(bool isLeftHanded)
@@ -168,6 +183,28 @@ void Camera::SetHandedNess(bool isLeftHanded)
 	UpdateONB();
 }
 
+void Camera::SetReverseZ(bool isReverseZ)
+{
+	if (m_IsReverseZ == isReverseZ) return;
+	m_IsReverseZ = isReverseZ;
+	UpdateProjection();
+}
+
+bool Camera::IsReverseZ() const
+{
+	return m_IsReverseZ;
+}
+
+bool Camera::IsDirty() const
+{
+	return m_IsDirty;
+}
+
+void Camera::ClearDirty()
+{
+	m_IsDirty = false;
+}
+
 void Camera::UpdateONB()
 {
 	Elite::FVector4 position{ m_Position };	
@@ -195,12 +232,20 @@ void Camera::UpdateONB()
 void Camera::UpdateProjection()
 {
 	UpdateFOV();
+	m_IsDirty = true;
 
 	m_Projection[0][0] = 1 / (m_AspectRatio * m_FOV);
 	m_Projection[1][1] = 1 / m_FOV;
+	m_Projection[2][3] = m_IsLeftHanded ? 1.f : -1.f;
+	if (m_IsReverseZ)
+	{
+		//Limit of the reversed projection for an infinite far plane, depth = near / w for both handednesses
+		m_Projection[2][2] = 0.f;
+		m_Projection[3][2] = m_NearPlaneZ;
+		return;
+	}
 	m_Projection[2][2] = m_IsLeftHanded ? (m_FarPlaneZ / (m_FarPlaneZ - m_NearPlaneZ)) : (m_FarPlaneZ / (m_NearPlaneZ - m_FarPlaneZ));
 	m_Projection[3][2] = m_IsLeftHanded ? (-(m_FarPlaneZ * m_NearPlaneZ) / (m_FarPlaneZ - m_NearPlaneZ)) : ((m_FarPlaneZ * m_NearPlaneZ) / (m_NearPlaneZ - m_FarPlaneZ));
-	m_Projection[2][3] = m_IsLeftHanded ? 1.f : -1.f;
 }
 
 const Elite::FVector3 Camera::GetLocalForward() const
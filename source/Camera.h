@@ -16,7 +16,15 @@ public:
 	float GetScreenWidth() const;
 	float GetScreenHeight() const;
 	bool FrustumCull(float z) const;
+	float GetNearPlane() const;
+	float GetFarPlane() const;
 	void SetHandedNess(bool isLeftHanded);
+	//Reverse-Z maps the near plane to depth 1 and has no far plane, depth goes to 0 at infinity and nothing is culled for being too far
+	void SetReverseZ(bool isReverseZ);
+	bool IsReverseZ() const;
+	//The camera moved or its projection changed since the last ClearDirty
+	bool IsDirty() const;
+	void ClearDirty();
 private:
 	float m_ScreenWidth;
 	float m_ScreenHeight;
@@ -39,6 +47,8 @@ private:
 	Elite::FMatrix4 m_Projection{};
 
 	bool m_IsLeftHanded = true;
+	bool m_IsReverseZ = false;
+	bool m_IsDirty = true;
 
 	void UpdateONB();
 	void UpdateProjection();
@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "DepthBuffer.h"
+
+DepthBuffer::DepthBuffer(uint32_t width, uint32_t height, Format format, bool useLargePages)
+	: m_Format{ format }
+	, m_Pixels{ width, height, GetPixelSize(format), useLargePages }
+{
+	Clear(0, 0, width, height);
+}
+
+DepthBuffer::Format DepthBuffer::GetFormat() const
+{
+	return m_Format;
+}
+
+bool DepthBuffer::IsReverseZ() const
+{
+	return m_Format == Format::Float32ReverseZ;
+}
+
+void DepthBuffer::Clear(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	switch (m_Format)
+	{
+	case Format::Float32ReverseZ:
+		ClearRect<Format::Float32ReverseZ>(x, y, width, height);
+		break;
+	case Format::Unorm24:
+		ClearRect<Format::Unorm24>(x, y, width, height);
+		break;
+	case Format::Unorm16:
+		ClearRect<Format::Unorm16>(x, y, width, height);
+		break;
+	}
+}
+
+void DepthBuffer::Copy(const DepthBuffer& source, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	m_Pixels.Copy(source.m_Pixels, x, y, width, height);
+}
+
+template<DepthBuffer::Format format>
+void DepthBuffer::ClearRect(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	m_Pixels.Fill<typename Traits<format>::Type>(x, y, width, height, Traits<format>::Far);
+}
+
+size_t DepthBuffer::GetPixelSize(Format format)
+{
+	switch (format)
+	{
+	case Format::Float32ReverseZ:
+		return sizeof(Traits<Format::Float32ReverseZ>::Type);
+	case Format::Unorm24:
+		return sizeof(Traits<Format::Unorm24>::Type);
+	case Format::Unorm16:
+		return sizeof(Traits<Format::Unorm16>::Type);
+	}
+	return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "TiledBuffer.h"
+
+//Depth buffer of the software rasterizer, stored in the type of its format and in the layout of TiledBuffer
+//The raster kernels are instantiated per format, so the depth test is a single compare of Traits<format>::IsCloser per pixel
+class DepthBuffer final
+{
+public:
+	enum class Format
+	{
+		//Reverse-Z with an infinite far plane, 1 at the near plane and 0 at infinity, floats keep their precision far away this way
+		Float32ReverseZ,
+		//0 at the near plane and 1 at the far plane, like DXGI_FORMAT_D24_UNORM_S8_UINT without the stencil
+		Unorm24,
+		//Half the memory traffic of the others, only for scenes with a short depth range
+		Unorm16
+	};
+	template<Format format>
+	struct Traits;
+
+	DepthBuffer(uint32_t width, uint32_t height, Format format, bool useLargePages = false);
+	~DepthBuffer() = default;
+
+	DepthBuffer(const DepthBuffer&) = delete;
+	DepthBuffer(DepthBuffer&&) noexcept = delete;
+	DepthBuffer& operator=(const DepthBuffer&) = delete;
+	DepthBuffer& operator=(DepthBuffer&&) noexcept = delete;
+
+	Format GetFormat() const;
+	//The camera needs the matching projection, see Camera::SetReverseZ
+	bool IsReverseZ() const;
+	//Fills a rectangle of pixels with the depth of the far plane, x and y are multiples of TiledBuffer::BlockSize
+	void Clear(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+	//Copies a rectangle from a depth buffer of the same size and format, x and y are multiples of TiledBuffer::BlockSize
+	void Copy(const DepthBuffer& source, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+	template<Format format>
+	typename Traits<format>::Type* GetData();
+private:
+	Format m_Format;
+	TiledBuffer m_Pixels;
+
+	template<Format format>
+	void ClearRect(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+	static size_t GetPixelSize(Format format);
+};
+
+template<>
+struct DepthBuffer::Traits<DepthBuffer::Format::Float32ReverseZ>
+{
+	using Type = float;
+	static constexpr Type Far{ 0.f };
+	static Type Encode(float depth) { return depth; }
+	static float Decode(Type depth) { return depth; }
+	static bool IsCloser(Type depth, Type other) { return depth > other; }
+};
+
+template<>
+struct DepthBuffer::Traits<DepthBuffer::Format::Unorm24>
+{
+	//The upper 8 bits stay 0
+	using Type = uint32_t;
+	static constexpr Type Far{ 0xFFFFFF };
+	static Type Encode(float depth) { return Type(std::clamp(depth, 0.f, 1.f) * float(Far) + 0.5f); }
+	static float Decode(Type depth) { return float(depth) / float(Far); }
+	static bool IsCloser(Type depth, Type other) { return depth < other; }
+};
+
+template<>
+struct DepthBuffer::Traits<DepthBuffer::Format::Unorm16>
+{
+	using Type = uint16_t;
+	static constexpr Type Far{ 0xFFFF };
+	static Type Encode(float depth) { return Type(std::clamp(depth, 0.f, 1.f) * float(Far) + 0.5f); }
+	static float Decode(Type depth) { return float(depth) / float(Far); }
+	static bool IsCloser(Type depth, Type other) { return depth < other; }
+};
+
+template<DepthBuffer::Format format>
+typename DepthBuffer::Traits<format>::Type* DepthBuffer::GetData()
+{
+	return m_Pixels.GetData<typename Traits<format>::Type>();
+}
+
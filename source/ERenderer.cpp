@@ -5,7 +5,7 @@
 #include "SceneGraph.h"
 #include "Triangle.h"
 
-Elite::Renderer::Renderer(SDL_Window * pWindow)
+Elite::Renderer::Renderer(SDL_Window * pWindow, uint32_t frameLatency, uint32_t backBufferCount, DepthBuffer::Format depthFormat, bool useLargePages)
 	: m_pWindow{ pWindow }
 	, m_Width{}
 	, m_Height{}
@@ -16,11 +16,47 @@ Elite::Renderer::Renderer(SDL_Window * pWindow)
 	m_Width = static_cast<uint32_t>(width);
 	m_Height = static_cast<uint32_t>(height);
 
+	m_AmountOfTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_AmountOfTilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+	const size_t amountOfTiles{ size_t(m_AmountOfTilesX) * size_t(m_AmountOfTilesY) };
+	m_TileTriangles.resize(amountOfTiles);
+	m_AmountOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
 	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+	m_BackBuffers.resize(std::clamp(backBufferCount, 1u, 3u));
+	const bool canDetileToFrontBuffer{ m_pFrontBuffer->format->format == SDL_PIXELFORMAT_RGB888 || m_pFrontBuffer->format->format == SDL_PIXELFORMAT_ARGB8888 };
+	m_IsPresentingDirectly = m_BackBuffers.size() == 1 && canDetileToFrontBuffer;
+	if (m_BackBuffers.size() == 1 && !canDetileToFrontBuffer) std::cout << "The window doesn't store 32 bit RGB pixels, the back buffer is presented through a copy" << '\n';
+	//Stores the pixels the way the back buffers do, so detiling is a plain copy, SDL converts when it blits to the window
+	if (!m_IsPresentingDirectly) m_pPresentSurface = SDL_CreateRGBSurfaceWithFormat(0, m_Width, m_Height, 32, SDL_PIXELFORMAT_RGB888);
+
+	for (BackBuffer& backBuffer : m_BackBuffers)
+	{
+		backBuffer.pPixels = new TiledBuffer{ m_Width, m_Height, sizeof(uint32_t), useLargePages };
+		backBuffer.IsTileCleared.assign(amountOfTiles, 1);
+	}
+	m_pBackBuffer = &m_BackBuffers[0];
+	m_pBackBufferPixels = m_pBackBuffer->pPixels->GetData<uint32_t>();
+
+	m_pDepthBuffer = new DepthBuffer{ m_Width, m_Height, depthFormat, useLargePages };
+	m_StaticLayer.pPixels = new TiledBuffer{ m_Width, m_Height, sizeof(uint32_t), useLargePages };
+	m_StaticLayer.IsTileCleared.assign(amountOfTiles, 1);
+	m_pStaticLayerDepth = new DepthBuffer{ m_Width, m_Height, depthFormat, useLargePages };
+	m_History.pPixels = new TiledBuffer{ m_Width, m_Height, sizeof(uint32_t), useLargePages };
+	m_History.IsTileCleared.assign(amountOfTiles, 1);
+	m_pHistoryDepth = new DepthBuffer{ m_Width, m_Height, depthFormat, useLargePages };
+	m_TileShadingRates.assign(amountOfTiles, ShadingRate::Rate1x1);
+	m_pAccumulation = new TiledBuffer{ m_Width, m_Height, sizeof(float) * 4, useLargePages };
+	m_pRevealage = new TiledBuffer{ m_Width, m_Height, sizeof(float), useLargePages };
+	m_pRevealage->Fill(0, 0, m_Width, m_Height, 1.f);
 
-	m_pDepthBuffer = new float[size_t(m_Width) * size_t(m_Height)];
+	m_Frames.resize(std::max(frameLatency, 1u));
+	m_GeometryThread = std::thread{ &Renderer::ProcessGeometry, this };
+	if (!m_IsPresentingDirectly) m_PresentThread = std::thread{ &Renderer::PresentBackBuffers, this };
+	//The rendering thread shades tiles as well
+	m_TileShadingCaches.resize(m_AmountOfThreads);
+	for (TileShadingCache& cache : m_TileShadingCaches) cache.Samples.assign(size_t(m_TileSize / 2) * (m_TileSize / 2), CoarseSample{ {}, 0.f, 0 });
+	for (uint32_t i = 1; i < m_AmountOfThreads; i++) m_TileThreads.emplace_back(&Renderer::ShadeTransparentTiles, this, i - 1);
 
 	std::cout << "Initializing DirectX" << '\n';
 	HRESULT result = InitializeDirectX();
@@ -38,6 +74,27 @@ Elite::Renderer::Renderer(SDL_Window * pWindow)
 
 Elite::Renderer::~Renderer()
 {
+	{
+		std::lock_guard<std::mutex> lock{ m_FrameMutex };
+		m_IsStopping = true;
+	}
+	m_FrameCondition.notify_all();
+	m_GeometryThread.join();
+	if (m_PresentThread.joinable()) m_PresentThread.join();
+	{
+		std::lock_guard<std::mutex> lock{ m_TileMutex };
+		m_AreTileThreadsStopping = true;
+	}
+	m_TileCondition.notify_all();
+	for (std::thread& thread : m_TileThreads) thread.join();
+	for (BackBuffer& backBuffer : m_BackBuffers)
+	{
+		delete backBuffer.pPixels;
+	}
+	delete m_StaticLayer.pPixels;
+	delete m_History.pPixels;
+	if (m_pPresentSurface) SDL_FreeSurface(m_pPresentSurface);
+
 	m_pRenderTargetView->Release();
 	m_pRenderTargetBuffer->Release();
 	m_pDepthStencilView->Release();
@@ -52,115 +109,501 @@ Elite::Renderer::~Renderer()
 	}
 	m_pDevice->Release();
 	delete m_pDepthBuffer;
+	delete m_pStaticLayerDepth;
+	delete m_pHistoryDepth;
+	delete m_pAccumulation;
+	delete m_pRevealage;
 }
 
-void Elite::Renderer::Render(Camera* pCamera)
+bool Elite::Renderer::Render(Camera* pCamera)
 {
 	if (!m_IsInitialized) 
-		return;
+		return false;
 
 	pCamera->UpdateFOV();
+	//Only the software rasterizer's depth buffer can be reversed
+	pCamera->SetReverseZ(!m_useDirectX && m_pDepthBuffer->IsReverseZ());
 
 	RGBColor clearColor = RGBColor{ 0.f, 0.f, 0.3f };
+
+	SceneGraph* pSceneGraph{ SceneGraph::GetInstance() };
+	const bool isDirty{ m_IsDirty || pCamera->IsDirty() || pSceneGraph->IsDirty() };
+	//The static layer only holds the view of the camera and the static meshes it was built with
+	bool isStaticLayerDirty{ m_IsDirty || pCamera->IsDirty() };
+	size_t amountOfStaticMeshes{ 0 };
+	for (const Mesh* pMesh : pSceneGraph->GetMeshes())
+	{
+		if (!IsInStaticLayer(pMesh)) continue;
+		isStaticLayerDirty |= pMesh->IsDirty() || amountOfStaticMeshes >= m_StaticLayerMeshes.size() || m_StaticLayerMeshes[amountOfStaticMeshes] != pMesh;
+		amountOfStaticMeshes++;
+	}
+	isStaticLayerDirty |= amountOfStaticMeshes != m_StaticLayerMeshes.size();
+	m_IsDirty = false;
+	if (m_IsEventDriven && !isDirty)
+	{
+		//The software frames still in flight are finished first, one per call, or the window would stay behind
+		if (m_useDirectX) return false;
+		if (m_RasterizedFrames == m_SubmittedFrames)
+		{
+			WaitForFrames([this]() { return m_PresentedFrames == m_RasterizedFrames; });
+			return false;
+		}
+		RasterizeNextFrame(clearColor);
+		return true;
+	}
 	
 	if (m_useDirectX)
 	{
 		m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView, &clearColor.r);
 		m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
+
+		//Render Meshes
+		std::vector<Mesh*>& meshes = SceneGraph::GetInstance()->GetMeshes();
+		for (Mesh* pMesh : meshes) RenderMesh(pMesh, pCamera);
+
+		m_pSwapChain->Present(0, 0);
+		pCamera->ClearDirty();
+		pSceneGraph->ClearDirty();
+		return true;
 	}
-	else
+
+	//Shows what the present thread detiled since the last call, without waiting for it
+	WaitForFrames([]() { return true; });
+
+	//The geometry of this frame is set up on the geometry thread while the frames before it are rasterized here
+	//The submitted frame still needs to know which meshes are dirty
+	SubmitFrame(pCamera, isStaticLayerDirty);
+	pCamera->ClearDirty();
+	pSceneGraph->ClearDirty();
+	if (m_SubmittedFrames - m_RasterizedFrames < m_Frames.size()) return true;
+
+	RasterizeNextFrame(clearColor);
+	return true;
+}
+
+void Elite::Renderer::RasterizeNextFrame(const RGBColor& clearColor)
+{
+	//Waits for the geometry of the frame and for the present thread to give up the back buffer it is rendered into
+	const Frame& frame{ m_Frames[m_RasterizedFrames % m_Frames.size()] };
+	WaitForFrames([this]()
 	{
-		SDL_LockSurface(m_pBackBuffer);
-		auto clearColorARGB = Elite::GetSDL_ARGBColor(clearColor);
-		size_t amount = size_t(m_Width) * size_t(m_Height);
-		std::fill_n(m_pBackBufferPixels, amount, clearColorARGB);
-		std::fill_n(m_pDepthBuffer, amount, FLT_MAX);
-	}
+		return m_ProcessedFrames > m_RasterizedFrames && m_RasterizedFrames - m_DetiledFrames < m_BackBuffers.size();
+	});
 
-	//Render Meshes
-	std::vector<Mesh*>& meshes = SceneGraph::GetInstance()->GetMeshes();
-	for (Mesh* pMesh : meshes) RenderMesh(pMesh, pCamera);
+	m_pBackBuffer = &m_BackBuffers[m_RasterizedFrames % m_BackBuffers.size()];
+	m_pBackBufferPixels = m_pBackBuffer->pPixels->GetData<uint32_t>();
+	//Nothing is cleared yet, tiles are cleared when they are first drawn into and the present thread fills the others
+	m_pBackBuffer->ClearColor = Elite::GetSDL_ARGBColor(clearColor);
+	std::fill(m_pBackBuffer->IsTileCleared.begin(), m_pBackBuffer->IsTileCleared.end(), uint8_t(1));
+
+	switch (m_pDepthBuffer->GetFormat())
+	{
+	case DepthBuffer::Format::Float32ReverseZ:
+		RasterizeFrame<DepthBuffer::Format::Float32ReverseZ>(frame);
+		break;
+	case DepthBuffer::Format::Unorm24:
+		RasterizeFrame<DepthBuffer::Format::Unorm24>(frame);
+		break;
+	case DepthBuffer::Format::Unorm16:
+		RasterizeFrame<DepthBuffer::Format::Unorm16>(frame);
+		break;
+	}
 
+	if (m_IsPresentingDirectly)
+	{
+		PresentDirectly();
+		return;
+	}
 
-	if (m_useDirectX)
+	//The present thread takes over the back buffer, the next frame is rendered into another one
 	{
-		m_pSwapChain->Present(0, 0);
+		std::lock_guard<std::mutex> lock{ m_FrameMutex };
+		m_RasterizedFrames++;
 	}
-	else 
+	m_FrameCondition.notify_all();
+}
+
+void Elite::Renderer::PresentDirectly()
+{
+	SDL_LockSurface(m_pFrontBuffer);
+	DetileBackBuffer(*m_pBackBuffer, static_cast<uint8_t*>(m_pFrontBuffer->pixels), m_pFrontBuffer->pitch);
+	SDL_UnlockSurface(m_pFrontBuffer);
+	SDL_UpdateWindowSurface(m_pWindow);
+
+	//The back buffer is free for the next frame right away
 	{
-		SDL_UnlockSurface(m_pBackBuffer);
-		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-		SDL_UpdateWindowSurface(m_pWindow);
+		std::lock_guard<std::mutex> lock{ m_FrameMutex };
+		m_RasterizedFrames++;
+		m_DetiledFrames++;
+		m_PresentedFrames++;
 	}
-	
+	m_FrameCondition.notify_all();
 }
 
 bool Elite::Renderer::ToggleDirectXRasterizer()
 {
+	Flush();
 	m_useDirectX = !m_useDirectX;
+	m_IsDirty = true;
 	return m_useDirectX;
 }
 
+bool Elite::Renderer::ToggleEventDriven()
+{
+	m_IsEventDriven = !m_IsEventDriven;
+	m_IsDirty = true;
+	return m_IsEventDriven;
+}
+
+bool Elite::Renderer::ToggleTemporalReprojection()
+{
+	m_UseTemporalReprojection = !m_UseTemporalReprojection;
+	m_HasHistory = false;
+	m_IsDirty = true;
+	return m_UseTemporalReprojection;
+}
+
+bool Elite::Renderer::ToggleVariableRateShading()
+{
+	m_UseVariableRateShading = !m_UseVariableRateShading;
+	m_IsDirty = true;
+	return m_UseVariableRateShading;
+}
+
+void Elite::Renderer::SetShadingRateImage(const std::vector<ShadingRate>& rates)
+{
+	//Only read when a frame is rasterized, which happens on this thread
+	m_ShadingRateImage = rates;
+	m_IsDirty = true;
+}
+
+void Elite::Renderer::GetShadingRateImageSize(uint32_t& width, uint32_t& height) const
+{
+	width = m_AmountOfTilesX;
+	height = m_AmountOfTilesY;
+}
+
+void Elite::Renderer::Invalidate()
+{
+	m_IsDirty = true;
+}
+
 ID3D11Device* Elite::Renderer::GetDevice()
 {
 	return m_pDevice;
 }
 
+void Elite::Renderer::Flush()
+{
+	WaitForFrames([this]() { return m_ProcessedFrames == m_SubmittedFrames && m_PresentedFrames == m_RasterizedFrames; });
+	std::lock_guard<std::mutex> lock{ m_FrameMutex };
+	m_RasterizedFrames = m_SubmittedFrames;
+	m_DetiledFrames = m_SubmittedFrames;
+	m_PresentedFrames = m_SubmittedFrames;
+	//The frame that would have built the static layer may be one of the dropped ones
+	m_HasStaticLayer = false;
+	m_HasHistory = false;
+}
+
 void Elite::Renderer::RenderMesh(Mesh* pMesh, const Camera* pCamera)
 {
 	pMesh->Update(pCamera);
 
-	if (m_useDirectX)
+	pMesh->UploadInstances(m_pDeviceContext);
+	if (!pMesh->GetInstanceBufferGPU()) return;
+
+	auto vertexLayout = pMesh->GetInputLayout();
+	auto indexBuffer = pMesh->GetIndexBufferGPU();
+	auto effect = pMesh->GetEffect();
+	const std::vector<Mesh::Lod>& lods = pMesh->GetLods();
+	const std::vector<uint32_t>& lodInstanceOffsets = pMesh->GetLodInstanceOffsets();
+
+	//One instanced draw per LOD that is in use, a batch drawn once only draws the ranges of its visible submeshes
+	m_Draws.clear();
+	for (uint32_t lod = 0; lod < lods.size(); lod++)
 	{
-		auto vertexLayout = pMesh->GetInputLayout();
-		auto vertexBuffer = pMesh->GetVertexBufferGPU();
-		auto indexBuffer = pMesh->GetIndexBufferGPU();
-		auto effect = pMesh->GetEffect();
-		int amountIndices = pMesh->GetAmountOfIndices();
+		const UINT amountInstances = lodInstanceOffsets[lod + 1] - lodInstanceOffsets[lod];
+		if (amountInstances == 0) continue;
+
+		if (amountInstances == 1 && pMesh->GetSubmeshes().size() > 1) AddVisibleSubmeshDraws(pMesh, lod, pCamera);
+		else m_Draws.push_back({ lods[lod].AmountIndices, amountInstances, lods[lod].FirstIndex, 0, lodInstanceOffsets[lod] });
+	}
+	if (m_Draws.empty()) return;
 
-		UINT stride = sizeof(Mesh::Vertex_Input);
-		UINT offset = 0;
-		m_pDeviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	//Slot 0 holds the vertices, slot 1 the instances
+	ID3D11Buffer* vertexBuffers[2]{ pMesh->GetVertexBufferGPU(), pMesh->GetInstanceBufferGPU() };
+	UINT strides[2]{ pMesh->GetVertexFormat().GetStride(), pMesh->GetInstanceStride() };
+	UINT offsets[2]{ 0, 0 };
+	m_pDeviceContext->IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
 
-		//Set index buffer
-		m_pDeviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	//Set index buffer
+	m_pDeviceContext->IASetIndexBuffer(indexBuffer, pMesh->GetIndexFormat(), 0);
 
-		//Set the input layout
-		m_pDeviceContext->IASetInputLayout(vertexLayout);
+	//Set the input layout
+	m_pDeviceContext->IASetInputLayout(vertexLayout);
 
-		//Set primitive topology
-		m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	//Set primitive topology
+	m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-		//Render the mesh
-		D3DX11_TECHNIQUE_DESC techDesc;
-		effect->GetTechnique()->GetDesc(&techDesc);
-		for (UINT p = 0; p < techDesc.Passes; ++p)
+	//Render the mesh
+	D3DX11_TECHNIQUE_DESC techDesc;
+	effect->GetTechnique()->GetDesc(&techDesc);
+	for (UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		effect->GetTechnique()->GetPassByIndex(p)->Apply(0, m_pDeviceContext);
+		for (const D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS& draw : m_Draws)
 		{
-			effect->GetTechnique()->GetPassByIndex(p)->Apply(0, m_pDeviceContext);
-			m_pDeviceContext->DrawIndexed(amountIndices, 0, 0);
+			m_pDeviceContext->DrawIndexedInstanced(draw.IndexCountPerInstance, draw.InstanceCount, draw.StartIndexLocation, draw.BaseVertexLocation, draw.StartInstanceLocation);
 		}
 	}
-	else
+}
+
+void Elite::Renderer::AddVisibleSubmeshDraws(const Mesh* pMesh, uint32_t lod, const Camera* pCamera)
+{
+	//Same space as the rasterizer, the submesh bounds are stored with z inverted
+	const Mesh::Instance& instance{ pMesh->GetLodInstance(pMesh->GetLodInstanceOffsets()[lod]) };
+	Elite::FMatrix4 meshWorldMatrix{ instance.World };
+	meshWorldMatrix[3][2] *= -1;
+	const Elite::FMatrix4 worldViewProj{ pCamera->GetProjection() * pCamera->GetView() * meshWorldMatrix };
+
+	//The submeshes of a LOD follow each other in the index buffer, neighbouring visible submeshes are merged into one draw
+	const std::vector<Mesh::Submesh>& submeshes{ pMesh->GetSubmeshes() };
+	const size_t firstDraw{ m_Draws.size() };
+	for (uint32_t submesh = 0; submesh < submeshes.size(); submesh++)
 	{
-		auto& vertexBuffer = pMesh->GetVertexBuffer();
-		auto& indexBuffer = pMesh->GetIndexBuffer();
-		Elite::FMatrix4 meshWorldMatrix{ pMesh->GetWorldMatrix() };
-		meshWorldMatrix[3][2] *= -1; //Invert Z component because it's defined in LH space
-		Elite::FMatrix4 worldViewProj{ pCamera->GetProjection() * pCamera->GetView() * meshWorldMatrix };
-		for (size_t i = 0; i < indexBuffer.size(); i+=3)
+		if (IsBoxOutsideFrustum(submeshes[submesh].BoundsMin, submeshes[submesh].BoundsMax, worldViewProj, pCamera)) continue;
+
+		const Mesh::Lod& submeshLod{ pMesh->GetSubmeshLod(lod, submesh) };
+		if (submeshLod.AmountIndices == 0) continue;
+
+		if (m_Draws.size() > firstDraw)
+		{
+			D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS& previous{ m_Draws.back() };
+			if (previous.StartIndexLocation + previous.IndexCountPerInstance == submeshLod.FirstIndex)
+			{
+				previous.IndexCountPerInstance += submeshLod.AmountIndices;
+				continue;
+			}
+		}
+		m_Draws.push_back({ submeshLod.AmountIndices, 1, submeshLod.FirstIndex, 0, pMesh->GetLodInstanceOffsets()[lod] });
+	}
+}
+
+void Elite::Renderer::SubmitFrame(const Camera* pCamera, bool isStaticLayerDirty)
+{
+	//The frame that used this slot before is rasterized already, so the geometry thread is done with it
+	Frame& frame{ m_Frames[m_SubmittedFrames % m_Frames.size()] };
+	frame.View = *pCamera;
+	frame.Instances.clear();
+	frame.UsesStaticLayer = m_HasStaticLayer && !isStaticLayerDirty;
+	if (!frame.UsesStaticLayer) m_StaticLayerMeshes.clear();
+	m_HasStaticLayer = true;
+
+	std::vector<Mesh*>& meshes = SceneGraph::GetInstance()->GetMeshes();
+	for (Mesh* pMesh : meshes)
+	{
+		const bool isStatic{ IsInStaticLayer(pMesh) };
+		if (isStatic && frame.UsesStaticLayer) continue;
+		if (isStatic) m_StaticLayerMeshes.push_back(pMesh);
+
+		pMesh->Update(pCamera);
+		for (const Mesh::Instance& instance : pMesh->GetInstances())
+		{
+			Elite::FMatrix4 meshWorldMatrix{ instance.World };
+			meshWorldMatrix[3][2] *= -1; //Invert Z component because it's defined in LH space
+
+			//Blending has to be on for OIT, opaque pixels of a mesh that is toggled to no transparency still need the sorted order
+			frame.Instances.push_back(RasterInstance{ pMesh, meshWorldMatrix, instance.Tint, instance.Lod, pMesh->GetCullMode(),
+				pMesh->CanGoTransparant(), pMesh->IsTransparent(), pMesh->IsTransparent() && pMesh->IsOrderIndependent(), isStatic, !pMesh->IsDirty() });
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ m_FrameMutex };
+		m_SubmittedFrames++;
+	}
+	m_FrameCondition.notify_all();
+}
+
+void Elite::Renderer::ProcessGeometry()
+{
+	while (true)
+	{
+		Frame* pFrame{};
+		{
+			std::unique_lock<std::mutex> lock{ m_FrameMutex };
+			m_FrameCondition.wait(lock, [this]() { return m_IsStopping || m_ProcessedFrames < m_SubmittedFrames; });
+			if (m_IsStopping) return;
+
+			pFrame = &m_Frames[m_ProcessedFrames % m_Frames.size()];
+		}
+
+		//Only reads the snapshot and the geometry of the meshes, which doesn't change after they are created
+		SetupFrame(*pFrame);
+
+		{
+			std::lock_guard<std::mutex> lock{ m_FrameMutex };
+			m_ProcessedFrames++;
+		}
+		m_FrameCondition.notify_all();
+	}
+}
+
+void Elite::Renderer::PresentBackBuffers()
+{
+	while (true)
+	{
+		const BackBuffer* pBackBuffer{};
+		{
+			//m_pPresentSurface is free again once the rendering thread showed the frame in it
+			std::unique_lock<std::mutex> lock{ m_FrameMutex };
+			m_FrameCondition.wait(lock, [this]() { return m_IsStopping || (m_DetiledFrames < m_RasterizedFrames && m_DetiledFrames == m_PresentedFrames); });
+			if (m_IsStopping) return;
+
+			pBackBuffer = &m_BackBuffers[m_DetiledFrames % m_BackBuffers.size()];
+		}
+
+		//Plain memory writes, the surface is never locked and SDL is only called on the rendering thread
+		DetileBackBuffer(*pBackBuffer, static_cast<uint8_t*>(m_pPresentSurface->pixels), m_pPresentSurface->pitch);
+
+		{
+			std::lock_guard<std::mutex> lock{ m_FrameMutex };
+			m_DetiledFrames++;
+		}
+		m_FrameCondition.notify_all();
+	}
+}
+
+void Elite::Renderer::DetileBackBuffer(const BackBuffer& backBuffer, uint8_t* pPixels, int pitch) const
+{
+	//Runs of tiles on a row that were drawn into are detiled, runs that are still cleared are filled with the clear color
+	for (uint32_t tileY = 0; tileY < m_AmountOfTilesY; tileY++)
+	{
+		const uint8_t* pIsCleared{ backBuffer.IsTileCleared.data() + size_t(tileY) * m_AmountOfTilesX };
+		const uint32_t minY{ tileY * m_TileSize };
+		const uint32_t height{ std::min(minY + m_TileSize, m_Height) - minY };
+		uint32_t runStart{ 0 };
+		for (uint32_t tileX = 1; tileX <= m_AmountOfTilesX; tileX++)
+		{
+			if (tileX < m_AmountOfTilesX && pIsCleared[tileX] == pIsCleared[runStart]) continue;
+
+			const uint32_t minX{ runStart * m_TileSize };
+			const uint32_t width{ std::min(tileX * m_TileSize, m_Width) - minX };
+			if (!pIsCleared[runStart]) backBuffer.pPixels->Detile(minX, minY, width, height, pPixels, pitch);
+			else
+			{
+				for (uint32_t r = minY; r < minY + height; r++)
+				{
+					std::fill_n(reinterpret_cast<uint32_t*>(pPixels + size_t(r) * pitch) + minX, width, backBuffer.ClearColor);
+				}
+			}
+			runStart = tileX;
+		}
+	}
+}
+
+template<typename Predicate>
+void Elite::Renderer::WaitForFrames(Predicate isReady)
+{
+	std::unique_lock<std::mutex> lock{ m_FrameMutex };
+	while (true)
+	{
+		m_FrameCondition.wait(lock, [this, &isReady]() { return isReady() || m_PresentedFrames < m_DetiledFrames; });
+		if (m_PresentedFrames == m_DetiledFrames) return;
+
+		//The present thread may be waiting for this frame to be shown before it detiles the next one
+		lock.unlock();
+		ShowDetiledFrame();
+		lock.lock();
+	}
+}
+
+void Elite::Renderer::ShowDetiledFrame()
+{
+	SDL_BlitSurface(m_pPresentSurface, nullptr, m_pFrontBuffer, nullptr);
+	SDL_UpdateWindowSurface(m_pWindow);
+
+	{
+		std::lock_guard<std::mutex> lock{ m_FrameMutex };
+		m_PresentedFrames++;
+	}
+	m_FrameCondition.notify_all();
+}
+
+void Elite::Renderer::ClearTile(uint32_t tile)
+{
+	if (!m_pBackBuffer->IsTileCleared[tile]) return;
+	m_pBackBuffer->IsTileCleared[tile] = 0;
+
+	const uint32_t tileMinX{ (tile % m_AmountOfTilesX) * m_TileSize };
+	const uint32_t tileMinY{ (tile / m_AmountOfTilesX) * m_TileSize };
+	const uint32_t tileWidth{ std::min(tileMinX + m_TileSize, m_Width) - tileMinX };
+	const uint32_t tileMaxY{ std::min(tileMinY + m_TileSize, m_Height) };
+	m_pBackBuffer->pPixels->Fill(tileMinX, tileMinY, tileWidth, tileMaxY - tileMinY, m_pBackBuffer->ClearColor);
+	m_pDepthBuffer->Clear(tileMinX, tileMinY, tileWidth, tileMaxY - tileMinY);
+}
+
+void Elite::Renderer::ClearTiles(uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY)
+{
+	for (uint32_t tileY = minY / m_TileSize; tileY <= maxY / m_TileSize; tileY++)
+	{
+		for (uint32_t tileX = minX / m_TileSize; tileX <= maxX / m_TileSize; tileX++)
+		{
+			ClearTile(tileY * m_AmountOfTilesX + tileX);
+		}
+	}
+}
+
+void Elite::Renderer::SetupFrame(Frame& frame)
+{
+	frame.OpaqueTriangles.clear();
+	frame.TransparentTriangles.clear();
+	frame.StaticTriangles.clear();
+	for (uint32_t i = 0; i < frame.Instances.size(); i++)
+	{
+		const Mesh* pMesh{ frame.Instances[i].pMesh };
+		if (pMesh->GetIndexFormat() == DXGI_FORMAT_R16_UINT) SetupInstance(frame, i, pMesh->GetIndexBuffer16());
+		else SetupInstance(frame, i, pMesh->GetIndexBuffer32());
+	}
+}
+
+template<typename IndexType>
+void Elite::Renderer::SetupInstance(Frame& frame, uint32_t instanceIndex, const std::vector<IndexType>& indexBuffer)
+{
+	const RasterInstance& instance{ frame.Instances[instanceIndex] };
+	const Mesh* pMesh{ instance.pMesh };
+	const Camera* pCamera{ &*frame.View };
+	const Elite::FMatrix4& meshWorldMatrix{ instance.World };
+	Elite::FMatrix4 worldViewProj{ pCamera->GetProjection() * pCamera->GetView() * meshWorldMatrix };
+	if (IsBoxOutsideFrustum(pMesh->GetBoundsMin(), pMesh->GetBoundsMax(), worldViewProj, pCamera)) return;
+
+	//Whole meshlets are rejected before any of their vertices are transformed
+	CullMeshlets(instance, worldViewProj, pCamera);
+	TransformVertices(pMesh, worldViewProj, pCamera);
+
+	//Transparent triangles are drawn once every opaque one is done, static ones before every other
+	std::vector<RasterTriangle>& triangles{ instance.IsTransparent ? frame.TransparentTriangles : instance.IsStatic ? frame.StaticTriangles : frame.OpaqueTriangles };
+	const ProjectedVertices& projected{ m_ProjectedVertices };
+	const std::vector<Mesh::Meshlet>& meshlets{ pMesh->GetMeshlets() };
+	for (uint32_t meshletIndex : m_VisibleMeshlets)
+	{
+		const Mesh::Meshlet& meshlet{ meshlets[meshletIndex] };
+		for (size_t i = meshlet.FirstIndex; i < size_t(meshlet.FirstIndex) + meshlet.AmountIndices; i+=3)
 		{
-			//Setup triangle
 			int i0 = indexBuffer[i];
 			int i1 = indexBuffer[i + 1];
 			int i2 = indexBuffer[i + 2];
 
-			Triangle triangle{ vertexBuffer[i0],vertexBuffer[i1],vertexBuffer[i2] };
-			triangle.UpdateProjectionSpace(worldViewProj);
+			//Culling, only the full vertices of triangles that pass are unpacked
+			if (projected.IsCulled[i0] | projected.IsCulled[i1] | projected.IsCulled[i2]) continue;
 
-			//Culling
-			if (triangle.IsFrustumCulled(pCamera)) continue;
+			//Setup triangle
+			Triangle triangle{ pMesh->GetVertex(i0),pMesh->GetVertex(i1),pMesh->GetVertex(i2) };
+			triangle.SetProjectedVertices(Elite::FPoint4{ projected.X[i0], projected.Y[i0], projected.Z[i0], projected.W[i0] },
+				Elite::FPoint4{ projected.X[i1], projected.Y[i1], projected.Z[i1], projected.W[i1] },
+				Elite::FPoint4{ projected.X[i2], projected.Y[i2], projected.Z[i2], projected.W[i2] });
 
-			const BaseEffect::EffectCullMode& cullMode{ pMesh->GetCullMode() };
+			const BaseEffect::EffectCullMode& cullMode{ instance.CullMode };
 			if (cullMode != BaseEffect::EffectCullMode::None)
 			{
 				const Elite::FPoint3 triangleMiddle{ triangle.GetTriangleMiddle(meshWorldMatrix) };
@@ -176,29 +619,211 @@ void Elite::Renderer::RenderMesh(Mesh* pMesh, const Camera* pCamera)
 			Elite::FPoint2 bottomRight{};
 			triangle.GetBoundingBox(topLeft, bottomRight, float(m_Width), float(m_Height));
 
-			//Loop over all the pixels in the bounding box
-			for (uint32_t r = uint32_t(topLeft.y); r <= bottomRight.y; ++r)
+			const float depth{ (projected.W[i0] + projected.W[i1] + projected.W[i2]) / 3.f };
+			triangles.push_back(RasterTriangle{ triangle, instanceIndex, depth,
+				uint32_t(topLeft.x), uint32_t(topLeft.y), uint32_t(bottomRight.x), uint32_t(bottomRight.y) });
+		}
+	}
+}
+
+bool Elite::Renderer::IsInStaticLayer(const Mesh* pMesh)
+{
+	//Transparent meshes are blended after every opaque one, so they can't be part of the layer
+	return pMesh->IsStatic() && !pMesh->CanGoTransparant();
+}
+
+template<DepthBuffer::Format format>
+void Elite::Renderer::RasterizeFrame(const Frame& frame)
+{
+	UpdateShadingRates();
+	if (m_UseTemporalReprojection && m_HasHistory)
+	{
+		m_Reprojection = m_HistoryViewProj * Elite::Inverse(frame.View->GetProjection() * frame.View->GetView());
+	}
+
+	//Only the dynamic meshes are drawn over a static layer that is still valid
+	if (frame.UsesStaticLayer) CopyDrawnTiles(m_StaticLayer, *m_pStaticLayerDepth, *m_pBackBuffer, *m_pDepthBuffer);
+	else
+	{
+		RasterizeOpaque<format>(frame, frame.StaticTriangles);
+		CopyDrawnTiles(*m_pBackBuffer, *m_pDepthBuffer, m_StaticLayer, *m_pStaticLayerDepth);
+	}
+
+	RasterizeOpaque<format>(frame, frame.OpaqueTriangles);
+
+	//The history only holds opaque pixels, transparent ones are blended over them every frame
+	if (m_UseTemporalReprojection)
+	{
+		const Elite::FMatrix4& projection{ frame.View->GetProjection() };
+		m_HistoryViewProj = projection * frame.View->GetView();
+		m_HistoryDepthScale = projection.data[3][2];
+		m_HistoryDepthOffset = projection.data[2][2] * projection.data[2][3];
+		CopyDrawnTiles(*m_pBackBuffer, *m_pDepthBuffer, m_History, *m_pHistoryDepth);
+		m_HasHistory = true;
+		m_TemporalFrame++;
+	}
+
+	ResolveTransparency<format>(frame);
+}
+
+void Elite::Renderer::UpdateShadingRates()
+{
+	if (!m_UseVariableRateShading)
+	{
+		std::fill(m_TileShadingRates.begin(), m_TileShadingRates.end(), ShadingRate::Rate1x1);
+		return;
+	}
+	if (m_ShadingRateImage.size() == m_TileShadingRates.size())
+	{
+		m_TileShadingRates = m_ShadingRateImage;
+		return;
+	}
+
+	const float halfDiagonal{ sqrtf(float(m_Width) * float(m_Width) + float(m_Height) * float(m_Height)) / 2.f };
+	for (uint32_t tile = 0; tile < m_TileShadingRates.size(); tile++)
+	{
+		//Distance of the middle of the tile to the middle of the screen
+		const float x{ ((tile % m_AmountOfTilesX) + 0.5f) * m_TileSize - m_Width / 2.f };
+		const float y{ ((tile / m_AmountOfTilesX) + 0.5f) * m_TileSize - m_Height / 2.f };
+		const float eccentricity{ sqrtf(x * x + y * y) / halfDiagonal };
+		if (eccentricity < m_FovealRadius) m_TileShadingRates[tile] = ShadingRate::Rate1x1;
+		else if (eccentricity < m_PeripheralRadius) m_TileShadingRates[tile] = ShadingRate::Rate2x2;
+		else m_TileShadingRates[tile] = ShadingRate::Rate4x4;
+	}
+}
+
+Elite::Renderer::ShadingRate Elite::Renderer::GetDistanceShadingRate(float distance)
+{
+	if (distance < m_HalfRateDistance) return ShadingRate::Rate1x1;
+	if (distance < m_QuarterRateDistance) return ShadingRate::Rate2x2;
+	return ShadingRate::Rate4x4;
+}
+
+template<DepthBuffer::Format format>
+bool Elite::Renderer::ReprojectShading(uint32_t x, uint32_t y, float depth, float distance, uint32_t& color) const
+{
+	using Depth = DepthBuffer::Traits<format>;
+	//The clip space position of this frame is the normalized one times the distance, so w comes out as the distance to the camera in the previous frame
+	const Elite::FPoint4 currentClip{ (float(x) / m_Width * 2.f - 1.f) * distance, (1.f - float(y) / m_Height * 2.f) * distance, depth * distance, distance };
+	const Elite::FPoint4 clip{ m_Reprojection * currentClip };
+	if (clip.w <= 0.f) return false;
+
+	const float historyX{ (clip.x / clip.w + 1.f) / 2.f * m_Width + 0.5f };
+	const float historyY{ (1.f - clip.y / clip.w) / 2.f * m_Height + 0.5f };
+	if (!(historyX >= 0.f && historyY >= 0.f && historyX < float(m_Width) && historyY < float(m_Height))) return false;
+
+	const uint32_t pixelX{ uint32_t(historyX) };
+	const uint32_t pixelY{ uint32_t(historyY) };
+	if (m_History.IsTileCleared[(pixelY / m_TileSize) * m_AmountOfTilesX + pixelX / m_TileSize]) return false;
+
+	//Disoccluded, something else was in front of the surface in the previous frame
+	const size_t historyIndex{ m_History.pPixels->GetIndex(pixelX, pixelY) };
+	const float historyDistance{ m_HistoryDepthScale / (Depth::Decode(m_pHistoryDepth->GetData<format>()[historyIndex]) - m_HistoryDepthOffset) };
+	if (!(abs(historyDistance - clip.w) <= m_ReprojectionTolerance * clip.w)) return false;
+
+	color = m_History.pPixels->GetData<uint32_t>()[historyIndex];
+	return true;
+}
+
+void Elite::Renderer::CopyDrawnTiles(const BackBuffer& source, const DepthBuffer& sourceDepth, BackBuffer& destination, DepthBuffer& destinationDepth)
+{
+	for (uint32_t tile = 0; tile < source.IsTileCleared.size(); tile++)
+	{
+		destination.IsTileCleared[tile] = source.IsTileCleared[tile];
+		if (source.IsTileCleared[tile]) continue;
+
+		const uint32_t tileMinX{ (tile % m_AmountOfTilesX) * m_TileSize };
+		const uint32_t tileMinY{ (tile / m_AmountOfTilesX) * m_TileSize };
+		const uint32_t tileWidth{ std::min(tileMinX + m_TileSize, m_Width) - tileMinX };
+		const uint32_t tileHeight{ std::min(tileMinY + m_TileSize, m_Height) - tileMinY };
+		destination.pPixels->Copy(*source.pPixels, tileMinX, tileMinY, tileWidth, tileHeight);
+		destinationDepth.Copy(sourceDepth, tileMinX, tileMinY, tileWidth, tileHeight);
+	}
+}
+
+template<DepthBuffer::Format format>
+void Elite::Renderer::RasterizeOpaque(const Frame& frame, const std::vector<RasterTriangle>& triangles)
+{
+	using Depth = DepthBuffer::Traits<format>;
+	typename Depth::Type* pDepthBuffer{ m_pDepthBuffer->GetData<format>() };
+	const TiledBuffer& pixels{ *m_pBackBuffer->pPixels };
+	const Camera* pCamera{ &*frame.View };
+	const bool canReproject{ m_UseTemporalReprojection && m_HasHistory };
+	const uint32_t refreshPixel{ m_TemporalFrame % m_RefreshPeriod };
+	for (const RasterTriangle& rasterTriangle : triangles)
+	{
+		const RasterInstance& instance{ frame.Instances[rasterTriangle.Instance] };
+		const Mesh* pMesh{ instance.pMesh };
+		const Triangle& triangle{ rasterTriangle.Geometry };
+		const bool canReuseShading{ canReproject && instance.IsShadingReusable };
+		ClearTiles(rasterTriangle.MinX, rasterTriangle.MinY, rasterTriangle.MaxX, rasterTriangle.MaxY);
+
+		//Blocks are aligned to their size, so every block lies within a single tile and has a single rate
+		const uint32_t triangleRate{ m_UseVariableRateShading ? uint32_t(GetDistanceShadingRate(rasterTriangle.Depth)) : 1u };
+		const uint32_t coarseMinX{ rasterTriangle.MinX / 4 * 4 };
+		const uint32_t coarseMinY{ rasterTriangle.MinY / 4 * 4 };
+		const size_t coarseWidth{ (rasterTriangle.MaxX - coarseMinX) / 2 + 1 };
+		if (m_UseVariableRateShading)
+		{
+			const size_t coarseSize{ coarseWidth * ((rasterTriangle.MaxY - coarseMinY) / 2 + 1) };
+			if (m_CoarseStamps.size() < coarseSize)
+			{
+				m_CoarseColors.resize(coarseSize);
+				m_CoarseStamps.resize(coarseSize, 0);
+			}
+			if (++m_CoarseStamp == 0)
 			{
-				for (uint32_t c = uint32_t(topLeft.x); c <= bottomRight.x; ++c)
+				std::fill(m_CoarseStamps.begin(), m_CoarseStamps.end(), 0);
+				m_CoarseStamp = 1;
+			}
+		}
+
+		//Loop over all the pixels in the bounding box
+		for (uint32_t r = rasterTriangle.MinY; r <= rasterTriangle.MaxY; ++r)
+		{
+			for (uint32_t c = rasterTriangle.MinX; c <= rasterTriangle.MaxX; ++c)
+			{
+				const size_t pixelIndex{ pixels.GetIndex(c, r) };
+				Elite::FPoint2 screenSpace{ float(c), float(r) };
+				Triangle::VertexOut vertexColor{};
+				float weight0{}, weight1{}, weight2{};
+
+				if (triangle.Hit(screenSpace, pCamera->GetScreenWidth(), pCamera->GetScreenHeight(), instance.CullMode == BaseEffect::EffectCullMode::Front, vertexColor, weight0, weight1, weight2))
 				{
-					uint32_t pixelIndex{ c + (r * m_Width) };
-					Elite::FPoint2 screenSpace{ float(c), float(r) };
-					Triangle::VertexOut vertexColor{};
-					float weight0{}, weight1{}, weight2{};
+					//Depth test
+					const typename Depth::Type depth{ Depth::Encode(vertexColor.position.z) };
+					if (!Depth::IsCloser(depth, pDepthBuffer[pixelIndex])) continue;
+
+					pDepthBuffer[pixelIndex] = depth;
+
+					//Every frame another pixel of every 4x2 block is shaded anyway, so view dependent lighting catches up
+					const bool isRefreshed{ ((c & 3) | ((r & 1) << 2)) == refreshPixel };
+					if (canReuseShading && !isRefreshed && ReprojectShading<format>(c, r, vertexColor.position.z, vertexColor.position.w, m_pBackBufferPixels[pixelIndex])) continue;
 
-					if (triangle.Hit(screenSpace, pCamera->GetScreenWidth(), pCamera->GetScreenHeight(), cullMode == BaseEffect::EffectCullMode::Front, vertexColor, weight0, weight1, weight2))
+					//The first covered pixel of a coarse block is shaded, the others of the triangle get its color
+					const uint32_t rate{ std::max(uint32_t(m_TileShadingRates[(r / m_TileSize) * m_AmountOfTilesX + c / m_TileSize]), triangleRate) };
+					size_t coarseIndex{};
+					if (rate > 1)
 					{
-						//Depth test
-						if (abs(vertexColor.position.z) >= abs(m_pDepthBuffer[pixelIndex])) continue;
+						coarseIndex = size_t((r / rate * rate - coarseMinY) / 2) * coarseWidth + (c / rate * rate - coarseMinX) / 2;
+						if (m_CoarseStamps[coarseIndex] == m_CoarseStamp)
+						{
+							m_pBackBufferPixels[pixelIndex] = m_CoarseColors[coarseIndex];
+							continue;
+						}
+					}
 
-						m_pDepthBuffer[pixelIndex] = vertexColor.position.z;
-						triangle.Interpolate(meshWorldMatrix, vertexColor, weight0, weight1, weight2);
+					triangle.Interpolate(instance.World, pMesh->GetVertexFormat(), vertexColor, weight0, weight1, weight2);
 
-						Elite::FVector3 viewDirection{ vertexColor.worldPosition - pCamera->GetPosition() };
-						Elite::Normalize(viewDirection);
-						Elite::RGBColor shadedColor = PixelShade(pMesh, vertexColor, viewDirection);
-						shadedColor.MaxToOne();
-						m_pBackBufferPixels[pixelIndex] = Elite::GetSDL_ARGBColor(shadedColor);
+					Elite::FVector3 viewDirection{ vertexColor.worldPosition - pCamera->GetPosition() };
+					Elite::Normalize(viewDirection);
+					Elite::RGBColor shadedColor = PixelShade(pMesh, vertexColor, viewDirection) * instance.Tint;
+					shadedColor.MaxToOne();
+					m_pBackBufferPixels[pixelIndex] = Elite::GetSDL_ARGBColor(shadedColor);
+					if (rate > 1)
+					{
+						m_CoarseColors[coarseIndex] = m_pBackBufferPixels[pixelIndex];
+						m_CoarseStamps[coarseIndex] = m_CoarseStamp;
 					}
 				}
 			}
@@ -206,6 +831,362 @@ void Elite::Renderer::RenderMesh(Mesh* pMesh, const Camera* pCamera)
 	}
 }
 
+template<DepthBuffer::Format format>
+void Elite::Renderer::ResolveTransparency(const Frame& frame)
+{
+	if (frame.TransparentTriangles.empty()) return;
+
+	//Binned in submission order, so the list of every tile starts out in that order too
+	for (uint32_t i = 0; i < frame.TransparentTriangles.size(); i++)
+	{
+		const RasterTriangle& triangle{ frame.TransparentTriangles[i] };
+		for (uint32_t tileY = triangle.MinY / m_TileSize; tileY <= triangle.MaxY / m_TileSize; tileY++)
+		{
+			for (uint32_t tileX = triangle.MinX / m_TileSize; tileX <= triangle.MaxX / m_TileSize; tileX++)
+			{
+				m_TileTriangles[tileY * m_AmountOfTilesX + tileX].push_back(i);
+			}
+		}
+	}
+
+	//Tiles share no pixels, so they need no locking and the order in which they are shaded doesn't matter
+	{
+		std::lock_guard<std::mutex> lock{ m_TileMutex };
+		m_pTileFrame = &frame;
+		m_pRasterizeTile = &Renderer::RasterizeTransparentTile<format>;
+		m_NextTile = 0;
+		m_FinishedTileThreads = 0;
+		m_TileJobs++;
+	}
+	m_TileCondition.notify_all();
+	ShadeNextTiles(m_TileShadingCaches[0]);
+
+	//The frame may only change once every tile thread is done with it
+	std::unique_lock<std::mutex> lock{ m_TileMutex };
+	m_TileCondition.wait(lock, [this]() { return m_FinishedTileThreads == m_TileThreads.size(); });
+}
+
+void Elite::Renderer::ShadeTransparentTiles(uint32_t thread)
+{
+	TileShadingCache& cache{ m_TileShadingCaches[thread + 1] };
+	uint64_t shadedJobs{ 0 };
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock{ m_TileMutex };
+			m_TileCondition.wait(lock, [this, shadedJobs]() { return m_AreTileThreadsStopping || m_TileJobs > shadedJobs; });
+			if (m_AreTileThreadsStopping) return;
+
+			shadedJobs = m_TileJobs;
+		}
+
+		ShadeNextTiles(cache);
+
+		{
+			std::lock_guard<std::mutex> lock{ m_TileMutex };
+			m_FinishedTileThreads++;
+		}
+		m_TileCondition.notify_all();
+	}
+}
+
+void Elite::Renderer::ShadeNextTiles(TileShadingCache& cache)
+{
+	const uint32_t amountOfTiles{ uint32_t(m_TileTriangles.size()) };
+	for (uint32_t tile = m_NextTile++; tile < amountOfTiles; tile = m_NextTile++) (this->*m_pRasterizeTile)(tile, *m_pTileFrame, cache);
+}
+
+template<DepthBuffer::Format format>
+void Elite::Renderer::RasterizeTransparentTile(uint32_t tile, const Frame& frame, TileShadingCache& cache)
+{
+	using Depth = DepthBuffer::Traits<format>;
+	const typename Depth::Type* pDepthBuffer{ m_pDepthBuffer->GetData<format>() };
+	const TiledBuffer& pixels{ *m_pBackBuffer->pPixels };
+	float* pAccumulationData{ m_pAccumulation->GetData<float>() };
+	float* pRevealage{ m_pRevealage->GetData<float>() };
+	const Camera* pCamera{ &*frame.View };
+	std::vector<uint32_t>& triangles{ m_TileTriangles[tile] };
+	if (triangles.empty()) return;
+	ClearTile(tile);
+
+	//Order independent triangles go last and stay in submission order, only the others are sorted
+	const auto orderIndependentBegin = std::stable_partition(triangles.begin(), triangles.end(), [&frame](uint32_t index)
+	{
+		return !frame.Instances[frame.TransparentTriangles[index].Instance].IsOrderIndependent;
+	});
+
+	//Back to front, equally deep triangles keep their submission order
+	std::sort(triangles.begin(), orderIndependentBegin, [&frame](uint32_t a, uint32_t b)
+	{
+		const float depthA{ frame.TransparentTriangles[a].Depth };
+		const float depthB{ frame.TransparentTriangles[b].Depth };
+		if (depthA != depthB) return depthA > depthB;
+		return a < b;
+	});
+
+	const uint32_t tileMinX{ (tile % m_AmountOfTilesX) * m_TileSize };
+	const uint32_t tileMinY{ (tile / m_AmountOfTilesX) * m_TileSize };
+	const uint32_t tileMaxX{ std::min(tileMinX + m_TileSize, m_Width) - 1 };
+	const uint32_t tileMaxY{ std::min(tileMinY + m_TileSize, m_Height) - 1 };
+
+	//Tiles are shaded in parallel, so the coarse blocks come from the cache of the thread shading this tile
+	std::vector<CoarseSample>& coarseSamples{ cache.Samples };
+	const uint32_t tileRate{ uint32_t(m_TileShadingRates[tile]) };
+
+	for (uint32_t i = 0; i < triangles.size(); i++)
+	{
+		const RasterTriangle& transparentTriangle{ frame.TransparentTriangles[triangles[i]] };
+		const RasterInstance& instance{ frame.Instances[transparentTriangle.Instance] };
+		const Triangle& triangle{ transparentTriangle.Geometry };
+		const uint32_t rate{ m_UseVariableRateShading ? std::max(tileRate, uint32_t(GetDistanceShadingRate(transparentTriangle.Depth))) : 1u };
+		//Every triangle of the tile starts with no valid blocks
+		if (++cache.Stamp == 0)
+		{
+			for (CoarseSample& sample : coarseSamples) sample.Stamp = 0;
+			cache.Stamp = 1;
+		}
+		const uint32_t stamp{ cache.Stamp };
+
+		for (uint32_t r = std::max(transparentTriangle.MinY, tileMinY); r <= std::min(transparentTriangle.MaxY, tileMaxY); ++r)
+		{
+			for (uint32_t c = std::max(transparentTriangle.MinX, tileMinX); c <= std::min(transparentTriangle.MaxX, tileMaxX); ++c)
+			{
+				const size_t pixelIndex{ pixels.GetIndex(c, r) };
+				Elite::FPoint2 screenSpace{ float(c), float(r) };
+				Triangle::VertexOut vertexColor{};
+				float weight0{}, weight1{}, weight2{};
+
+				if (!triangle.Hit(screenSpace, pCamera->GetScreenWidth(), pCamera->GetScreenHeight(), instance.CullMode == BaseEffect::EffectCullMode::Front, vertexColor, weight0, weight1, weight2)) continue;
+
+				//Depth test against the opaque meshes, transparent triangles don't write depth
+				if (!Depth::IsCloser(Depth::Encode(vertexColor.position.z), pDepthBuffer[pixelIndex])) continue;
+
+				//Color and alpha are shared by a coarse block, blending stays per pixel
+				CoarseSample* pSample{};
+				if (rate > 1) pSample = &coarseSamples[size_t((r / rate * rate - tileMinY) / 2) * (m_TileSize / 2) + (c / rate * rate - tileMinX) / 2];
+				float alpha{};
+				Elite::RGBColor shadedColor{};
+				if (pSample && pSample->Stamp == stamp)
+				{
+					shadedColor = pSample->Color;
+					alpha = pSample->Alpha;
+				}
+				else
+				{
+					triangle.Interpolate(instance.World, instance.pMesh->GetVertexFormat(), vertexColor, weight0, weight1, weight2);
+
+					shadedColor = TransparentShade(instance.pMesh, vertexColor, alpha) * instance.Tint;
+					shadedColor.MaxToOne();
+					if (!instance.IsBlended) alpha = 1.f;
+					if (pSample) *pSample = CoarseSample{ shadedColor, alpha, stamp };
+				}
+
+				if (instance.IsOrderIndependent)
+				{
+					const float weight{ GetOrderIndependentWeight(vertexColor.position.w, alpha) };
+					float* pAccumulation{ pAccumulationData + pixelIndex * 4 };
+					pAccumulation[0] += shadedColor.r * alpha * weight;
+					pAccumulation[1] += shadedColor.g * alpha * weight;
+					pAccumulation[2] += shadedColor.b * alpha * weight;
+					pAccumulation[3] += alpha * weight;
+					pRevealage[pixelIndex] *= 1.f - alpha;
+					continue;
+				}
+
+				const Elite::RGBColor destinationColor{ Elite::GetColorFromSDL_ARGB(m_pBackBufferPixels[pixelIndex]) };
+				m_pBackBufferPixels[pixelIndex] = Elite::GetSDL_ARGBColor(shadedColor * alpha + destinationColor * (1.f - alpha));
+			}
+		}
+	}
+
+	//The order independent triangles are composited over the sorted ones
+	if (orderIndependentBegin != triangles.end()) ResolveOrderIndependentTile(tileMinX, tileMinY, tileMaxX, tileMaxY);
+	triangles.clear();
+}
+
+void Elite::Renderer::ResolveOrderIndependentTile(uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY)
+{
+	const TiledBuffer& pixels{ *m_pBackBuffer->pPixels };
+	float* pAccumulationData{ m_pAccumulation->GetData<float>() };
+	float* pRevealage{ m_pRevealage->GetData<float>() };
+	for (uint32_t r = tileMinY; r <= tileMaxY; ++r)
+	{
+		for (uint32_t c = tileMinX; c <= tileMaxX; ++c)
+		{
+			const size_t pixelIndex{ pixels.GetIndex(c, r) };
+			float* pAccumulation{ pAccumulationData + pixelIndex * 4 };
+			const float revealage{ pRevealage[pixelIndex] };
+			if (pAccumulation[3] == 0.f) continue;
+
+			//Weighted average of the fragments, covering as much of the background as their alphas together
+			const float averageDivisor{ 1.f / std::max(pAccumulation[3], 1e-5f) };
+			const Elite::RGBColor averageColor{ pAccumulation[0] * averageDivisor, pAccumulation[1] * averageDivisor, pAccumulation[2] * averageDivisor };
+			const Elite::RGBColor destinationColor{ Elite::GetColorFromSDL_ARGB(m_pBackBufferPixels[pixelIndex]) };
+			m_pBackBufferPixels[pixelIndex] = Elite::GetSDL_ARGBColor(averageColor * (1.f - revealage) + destinationColor * revealage);
+
+			std::fill_n(pAccumulation, 4, 0.f);
+			pRevealage[pixelIndex] = 1.f;
+		}
+	}
+}
+
+float Elite::Renderer::GetOrderIndependentWeight(float depth, float alpha)
+{
+	const float nearTerm{ depth / 5.f };
+	const float farTerm{ depth / 200.f };
+	const float farTermCubed{ farTerm * farTerm * farTerm };
+	return alpha * Elite::Clamp(10.f / (1e-5f + nearTerm * nearTerm + farTermCubed * farTermCubed), 1e-2f, 3e3f);
+}
+
+void Elite::Renderer::CullMeshlets(const RasterInstance& instance, const Elite::FMatrix4& worldViewProj, const Camera* pCamera)
+{
+	m_VisibleMeshlets.clear();
+	const Mesh* pMesh{ instance.pMesh };
+	const Elite::FMatrix4& world{ instance.World };
+
+	//Frustum planes in object space (Gribb/Hartmann), taken from the rows of the world view projection matrix
+	//Points inside the frustum have -w <= x <= w, -w <= y <= w and near <= w <= far
+	const Elite::FMatrix4& m{ worldViewProj };
+	Elite::FVector4 planes[6]{
+		Elite::FVector4{ m(3, 0) + m(0, 0), m(3, 1) + m(0, 1), m(3, 2) + m(0, 2), m(3, 3) + m(0, 3) },
+		Elite::FVector4{ m(3, 0) - m(0, 0), m(3, 1) - m(0, 1), m(3, 2) - m(0, 2), m(3, 3) - m(0, 3) },
+		Elite::FVector4{ m(3, 0) + m(1, 0), m(3, 1) + m(1, 1), m(3, 2) + m(1, 2), m(3, 3) + m(1, 3) },
+		Elite::FVector4{ m(3, 0) - m(1, 0), m(3, 1) - m(1, 1), m(3, 2) - m(1, 2), m(3, 3) - m(1, 3) },
+		Elite::FVector4{ m(3, 0), m(3, 1), m(3, 2), m(3, 3) - pCamera->GetNearPlane() },
+		Elite::FVector4{ -m(3, 0), -m(3, 1), -m(3, 2), pCamera->GetFarPlane() - m(3, 3) } };
+	for (Elite::FVector4& plane : planes)
+	{
+		const float length{ Elite::Magnitude(Elite::FVector3{ plane.x, plane.y, plane.z }) };
+		if (length > 0.f) plane /= length;
+	}
+
+	//The cones are tested in world space, where the camera position is known
+	const BaseEffect::EffectCullMode& cullMode{ instance.CullMode };
+	const float worldScale{ std::max(std::max(
+		Elite::Magnitude(Elite::FVector3{ world * Elite::FVector4{ 1.f, 0.f, 0.f, 0.f } }),
+		Elite::Magnitude(Elite::FVector3{ world * Elite::FVector4{ 0.f, 1.f, 0.f, 0.f } })),
+		Elite::Magnitude(Elite::FVector3{ world * Elite::FVector4{ 0.f, 0.f, 1.f, 0.f } })) };
+
+	//The submeshes of a static batch are tested on their own first, a single submesh has the bounds of the mesh that were tested already
+	const std::vector<Mesh::Submesh>& submeshes{ pMesh->GetSubmeshes() };
+	const std::vector<Mesh::Meshlet>& meshlets{ pMesh->GetMeshlets() };
+	for (uint32_t submesh = 0; submesh < submeshes.size(); submesh++)
+	{
+		if (submeshes.size() > 1 && IsBoxOutsideFrustum(submeshes[submesh].BoundsMin, submeshes[submesh].BoundsMax, worldViewProj, pCamera)) continue;
+
+		//Only the meshlets of the LOD the instance uses are tested
+		const Mesh::Lod& submeshLod{ pMesh->GetSubmeshLod(instance.Lod, submesh) };
+		for (uint32_t i = submeshLod.FirstMeshlet; i < submeshLod.FirstMeshlet + submeshLod.AmountMeshlets; i++)
+		{
+			const Mesh::Meshlet& meshlet{ meshlets[i] };
+
+			bool isOutside{ false };
+			for (const Elite::FVector4& plane : planes)
+			{
+				const float distance{ plane.x * meshlet.Center.x + plane.y * meshlet.Center.y + plane.z * meshlet.Center.z + plane.w };
+				if (distance < -meshlet.Radius)
+				{
+					isOutside = true;
+					break;
+				}
+			}
+			if (isOutside) continue;
+
+			//Every triangle of the meshlet faces the culled side when the view direction stays within the normal cone for the whole bounding sphere
+			if (cullMode != BaseEffect::EffectCullMode::None && meshlet.ConeCutoff < 1.f)
+			{
+				const Elite::FPoint3 center{ world * Elite::FPoint4{ meshlet.Center } };
+				Elite::FVector3 axis{ world * Elite::FVector4{ meshlet.ConeAxis } };
+				Elite::Normalize(axis);
+				if (cullMode == BaseEffect::EffectCullMode::Front) axis *= -1;
+
+				const Elite::FVector3 viewDirection{ center - pCamera->GetPosition() };
+				if (Elite::Dot(viewDirection, axis) >= meshlet.ConeCutoff * Elite::Magnitude(viewDirection) + meshlet.Radius * worldScale) continue;
+			}
+
+			m_VisibleMeshlets.push_back(i);
+		}
+	}
+}
+
+void Elite::Renderer::TransformVertices(const Mesh* pMesh, const Elite::FMatrix4& worldViewProj, const Camera* pCamera)
+{
+	const Mesh::PositionStreams& positions{ pMesh->GetPositionStreams() };
+	const size_t amountVertices{ positions.X.size() };
+	m_ProjectedVertices.X.resize(amountVertices);
+	m_ProjectedVertices.Y.resize(amountVertices);
+	m_ProjectedVertices.Z.resize(amountVertices);
+	m_ProjectedVertices.W.resize(amountVertices);
+	m_ProjectedVertices.IsCulled.resize(amountVertices);
+	m_ProjectedVertices.Stamps.resize(amountVertices, 0);
+	if (++m_ProjectedVertices.Stamp == 0)
+	{
+		std::fill(m_ProjectedVertices.Stamps.begin(), m_ProjectedVertices.Stamps.end(), 0);
+		m_ProjectedVertices.Stamp = 1;
+	}
+
+	//Only the vertices of visible meshlets are read and written, the rest of the arrays is left stale
+	//Vertices on the border of two meshlets are stamped the first time, so they are only transformed once
+	const uint32_t stamp{ m_ProjectedVertices.Stamp };
+	uint32_t* pStamps{ m_ProjectedVertices.Stamps.data() };
+	const Elite::FMatrix4& m{ worldViewProj };
+	const float* pX{ positions.X.data() };
+	const float* pY{ positions.Y.data() };
+	const float* pZ{ positions.Z.data() };
+	float* pOutX{ m_ProjectedVertices.X.data() };
+	float* pOutY{ m_ProjectedVertices.Y.data() };
+	float* pOutZ{ m_ProjectedVertices.Z.data() };
+	float* pOutW{ m_ProjectedVertices.W.data() };
+	uint8_t* pOutIsCulled{ m_ProjectedVertices.IsCulled.data() };
+	const std::vector<Mesh::Meshlet>& meshlets{ pMesh->GetMeshlets() };
+	const uint32_t* pMeshletVertices{ pMesh->GetMeshletVertices().data() };
+	for (uint32_t meshletIndex : m_VisibleMeshlets)
+	{
+		const Mesh::Meshlet& meshlet{ meshlets[meshletIndex] };
+		const uint32_t* pVertices{ pMeshletVertices + meshlet.FirstVertex };
+		for (uint32_t vertex = 0; vertex < meshlet.AmountVertices; vertex++)
+		{
+			const uint32_t i{ pVertices[vertex] };
+			if (pStamps[i] == stamp) continue;
+			pStamps[i] = stamp;
+
+			const float w{ m(3, 0) * pX[i] + m(3, 1) * pY[i] + m(3, 2) * pZ[i] + m(3, 3) };
+			const float x{ (m(0, 0) * pX[i] + m(0, 1) * pY[i] + m(0, 2) * pZ[i] + m(0, 3)) / w };
+			const float y{ (m(1, 0) * pX[i] + m(1, 1) * pY[i] + m(1, 2) * pZ[i] + m(1, 3)) / w };
+			pOutX[i] = x;
+			pOutY[i] = y;
+			pOutZ[i] = (m(2, 0) * pX[i] + m(2, 1) * pY[i] + m(2, 2) * pZ[i] + m(2, 3)) / w;
+			pOutW[i] = w;
+
+			//A triangle is culled as soon as one of its vertices is outside the frustum
+			//x y
+			//z in world space = w
+			pOutIsCulled[i] = x < -1 || x > 1 || y < -1 || y > 1 || pCamera->FrustumCull(w);
+		}
+	}
+}
+
+bool Elite::Renderer::IsBoxOutsideFrustum(const Elite::FPoint3& boundsMin, const Elite::FPoint3& boundsMax, const Elite::FMatrix4& worldViewProj, const Camera* pCamera)
+{
+	//The box is outside when all of its corners are on the outer side of the same plane, tested in clip space so corners behind the camera work too
+	bool isLeft{ true }, isRight{ true }, isBottom{ true }, isTop{ true }, isNear{ true }, isFar{ true };
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const Elite::FPoint4 clip{ worldViewProj * Elite::FPoint4{
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z, 1.f } };
+
+		isLeft &= clip.x < -clip.w;
+		isRight &= clip.x > clip.w;
+		isBottom &= clip.y < -clip.w;
+		isTop &= clip.y > clip.w;
+		isNear &= clip.w < pCamera->GetNearPlane();
+		isFar &= clip.w > pCamera->GetFarPlane();
+	}
+	return isLeft || isRight || isBottom || isTop || isNear || isFar;
+}
+
 Elite::RGBColor Elite::Renderer::PixelShade(const Mesh* pMesh, const Triangle::VertexOut& vertex, const Elite::FVector3& viewDirection) const
 {
 	Elite::FVector3 vertexNormal{ vertex.normal };
@@ -257,6 +1238,15 @@ Elite::RGBColor Elite::Renderer::PixelShade(const Mesh* pMesh, const Triangle::V
 	return diffuse + specularColor * specularReflection;
 }
 
+Elite::RGBColor Elite::Renderer::TransparentShade(const Mesh* pMesh, const Triangle::VertexOut& vertex, float& alpha) const
+{
+	alpha = 1.f;
+	const Texture* pDiffuse = pMesh->GetDiffuse();
+	if (pDiffuse == nullptr) return vertex.color;
+
+	return pDiffuse->Sample(vertex.uv, alpha);
+}
+
 HRESULT Elite::Renderer::InitializeDirectX()
 {
 	//Create Device and Device context, using hardware acceleration
@@ -7,8 +7,16 @@
 #ifndef ELITE_RAYTRACING_RENDERER
 #define	ELITE_RAYTRACING_RENDERER
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "DepthBuffer.h"
 #include "Mesh.h"
+#include "TiledBuffer.h"
 #include "Triangle.h"
 
 struct SDL_Window;
@@ -19,7 +27,15 @@ namespace Elite
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		//frameLatency is the amount of software rasterizer frames in flight, with 1 every frame is rasterized right after its geometry
+		//With more, the geometry of the next frames is processed on another thread while this one is rasterized, and the image lags behind
+		//backBufferCount is 2 for double or 3 for triple buffering, the present thread detiles one back buffer while the others are rendered into
+		//With 1 there is a single back buffer, detiled straight into the locked window surface after it is rasterized when the window stores 32 bit RGB pixels
+		//The window itself is only touched by the thread that calls Render, SDL doesn't allow its video calls on other threads
+		//depthFormat is the software rasterizer's depth buffer, DirectX keeps its own D24 buffer and a regular projection
+		//useLargePages backs the color, depth and OIT buffers of the software rasterizer with large pages when the process may lock them
+		Renderer(SDL_Window* pWindow, uint32_t frameLatency = 2, uint32_t backBufferCount = 2, DepthBuffer::Format depthFormat = DepthBuffer::Format::Float32ReverseZ,
+			bool useLargePages = false);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -27,28 +43,284 @@ namespace Elite
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Camera* pCamera);
+		//Returns false when nothing was drawn, the window still shows the last frame
+		bool Render(Camera* pCamera);
 		bool ToggleDirectXRasterizer();
+		//Event driven, frames are only drawn when the camera, the scene graph or one of its meshes is dirty
+		//Otherwise the window keeps the previous frame and the caller can sleep until the next event
+		bool ToggleEventDriven();
+		//Draws the next frame even when nothing is dirty, e.g. when the window has to be repainted
+		void Invalidate();
+		//The software rasterizer reuses the color of the previous frame for pixels that were visible there at the same depth
+		//Only disoccluded pixels, pixels of meshes that changed and a rotating 1 in m_RefreshPeriod pixels are shaded
+		bool ToggleTemporalReprojection();
+
+		//Size of the pixel blocks of the software rasterizer that share one shaded color, coverage and depth stay per pixel
+		enum class ShadingRate : uint8_t
+		{
+			Rate1x1 = 1,
+			Rate2x2 = 2,
+			Rate4x4 = 4
+		};
+		//Without a rate image the rate of a tile comes from foveation, coarser away from the middle of the screen
+		//Triangles far from the camera are shaded coarser as well
+		bool ToggleVariableRateShading();
+		//One rate per tile of GetShadingRateImageSize, row after row, an image of another size turns foveation back on
+		void SetShadingRateImage(const std::vector<ShadingRate>& rates);
+		void GetShadingRateImageSize(uint32_t& width, uint32_t& height) const;
 		ID3D11Device* GetDevice();
+		//Waits for the geometry and present threads and drops the frames in flight, needed before meshes are deleted or the window is destroyed
+		void Flush();
 
 	private:
+		//Everything of a mesh instance the software rasterizer needs, copied when the frame is submitted
+		struct RasterInstance
+		{
+			const Mesh* pMesh;
+			//Inverted Z, the rasterizer's space
+			Elite::FMatrix4 World;
+			Elite::RGBColor Tint;
+			uint32_t Lod;
+			BaseEffect::EffectCullMode CullMode;
+			//Transparent triangles are drawn after every opaque one, without writing depth
+			bool IsTransparent;
+			bool IsBlended;
+			bool IsOrderIndependent;
+			bool IsStatic;
+			//The mesh didn't change since the previous frame, so its pixels in the history are still valid
+			bool IsShadingReusable;
+		};
+		struct RasterTriangle
+		{
+			Triangle Geometry;
+			uint32_t Instance;
+			//Distance to the camera of the middle of the triangle
+			float Depth;
+			//Pixel bounding box
+			uint32_t MinX, MinY, MaxX, MaxY;
+		};
+		struct BackBuffer
+		{
+			//0x00RRGGBB
+			TiledBuffer* pPixels;
+			//Tiles nothing was drawn into hold stale pixels, they are only cleared once they are drawn into or when they are presented
+			//Written by the tile pass in parallel, so no vector<bool>
+			std::vector<uint8_t> IsTileCleared;
+			uint32_t ClearColor;
+		};
+		//Snapshot of the scene and the triangles the geometry thread set up for it
+		struct Frame
+		{
+			std::optional<Camera> View;
+			std::vector<RasterInstance> Instances;
+			std::vector<RasterTriangle> OpaqueTriangles;
+			//In submission order, which breaks ties between equally deep triangles so the result doesn't depend on the amount of threads
+			std::vector<RasterTriangle> TransparentTriangles;
+			//Only when the frame builds the static layer, they are drawn before every other triangle
+			std::vector<RasterTriangle> StaticTriangles;
+			//The static layer is copied into the back buffer instead, the frame holds no static instances
+			bool UsesStaticLayer;
+		};
+
 		void RenderMesh(Mesh* pMesh, const Camera* pCamera);
+		//Adds a draw to m_Draws for every run of consecutive submeshes of lod that are (partly) inside the frustum
+		void AddVisibleSubmeshDraws(const Mesh* pMesh, uint32_t lod, const Camera* pCamera);
+		//Waits for the oldest submitted frame and rasterizes it into the next back buffer
+		void RasterizeNextFrame(const RGBColor& clearColor);
+		//Snapshots the scene into the next frame and hands it to the geometry thread
+		//The frame reuses the static layer unless isStaticLayerDirty, then it leaves out the static meshes
+		void SubmitFrame(const Camera* pCamera, bool isStaticLayerDirty);
+		//Static opaque meshes are drawn once into the static layer and copied from it as long as they and the camera don't change
+		static bool IsInStaticLayer(const Mesh* pMesh);
+		//Body of the geometry thread, sets up the triangles of every submitted frame in order
+		void ProcessGeometry();
+		void SetupFrame(Frame& frame);
+		//Instances share the bounds, meshlets and vertices of the mesh, only the transform and the tint differ
+		template<typename IndexType>
+		void SetupInstance(Frame& frame, uint32_t instanceIndex, const std::vector<IndexType>& indexBuffer);
+		//Instantiated per depth format, Render picks the one of m_pDepthBuffer
+		template<DepthBuffer::Format format>
+		void RasterizeFrame(const Frame& frame);
+		template<DepthBuffer::Format format>
+		void RasterizeOpaque(const Frame& frame, const std::vector<RasterTriangle>& triangles);
+		//Fills m_TileShadingRates from the rate image or from foveation
+		void UpdateShadingRates();
+		static ShadingRate GetDistanceShadingRate(float distance);
+		//Looks up the pixel at depth in the previous frame, returns false when it wasn't visible there or the history is cleared
+		//depth is the normalized depth of the pixel, distance its distance to the camera, the w of its clip space position
+		template<DepthBuffer::Format format>
+		bool ReprojectShading(uint32_t x, uint32_t y, float depth, float distance, uint32_t& color) const;
+		//Copies the tiles that were drawn into from one back buffer and depth buffer to another, the others stay cleared
+		void CopyDrawnTiles(const BackBuffer& source, const DepthBuffer& sourceDepth, BackBuffer& destination, DepthBuffer& destinationDepth);
+		//Body of the present thread, detiles every finished back buffer into m_pPresentSurface in order
+		void PresentBackBuffers();
+		//Writes the back buffer to row major 0x00RRGGBB pixels, drawn runs of tiles are detiled and cleared ones filled
+		void DetileBackBuffer(const BackBuffer& backBuffer, uint8_t* pPixels, int pitch) const;
+		//Detiles the back buffer into the window surface itself, without the staging copy, only on the rendering thread
+		void PresentDirectly();
+		//Waits on the rendering thread until isReady, frames the present thread detiled meanwhile are shown in the window
+		template<typename Predicate>
+		void WaitForFrames(Predicate isReady);
+		//Blits the detiled frame to the window, only on the rendering thread
+		void ShowDetiledFrame();
+		//Fills the color and depth of a tile of the current back buffer with their clear values the first time it is drawn into
+		void ClearTile(uint32_t tile);
+		void ClearTiles(uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY);
 		Elite::RGBColor PixelShade(const Mesh* pMesh, const Triangle::VertexOut& vertex, const Elite::FVector3& viewDirection) const;
+		//Unlit like TransparantShading.fx, alpha comes from the diffuse map
+		Elite::RGBColor TransparentShade(const Mesh* pMesh, const Triangle::VertexOut& vertex, float& alpha) const;
+		//Blends the transparent triangles over the opaque image, every tile sorts its own triangles back to front and tiles are shaded in parallel
+		template<DepthBuffer::Format format>
+		void ResolveTransparency(const Frame& frame);
+		//Colors and alphas shaded for the coarse blocks of a tile, every thread that shades tiles has its own
+		struct CoarseSample
+		{
+			Elite::RGBColor Color;
+			float Alpha;
+			uint32_t Stamp;
+		};
+		//Aligned so the stamps of different threads don't share a cache line
+		struct alignas(64) TileShadingCache
+		{
+			//Counted in 2x2 pixels from the corner of the tile, valid when their stamp is Stamp
+			std::vector<CoarseSample> Samples;
+			uint32_t Stamp = 0;
+		};
+		template<DepthBuffer::Format format>
+		void RasterizeTransparentTile(uint32_t tile, const Frame& frame, TileShadingCache& cache);
+		//Body of tile thread i, every one helps shading the tiles of each frame ResolveTransparency hands out
+		void ShadeTransparentTiles(uint32_t thread);
+		//Takes tiles of the current frame until none are left
+		void ShadeNextTiles(TileShadingCache& cache);
+		//Composites the weighted blended OIT buffers of a tile over the back buffer and clears them again
+		void ResolveOrderIndependentTile(uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY);
+		//Weight of a fragment in the accumulation buffer, nearer and more opaque fragments weigh more (McGuire, Bavoil 2013, equation 9)
+		static float GetOrderIndependentWeight(float depth, float alpha);
+		//Fills m_VisibleMeshlets with the meshlets of the instance's LOD that are (partly) inside the frustum and not entirely facing the culled side
+		void CullMeshlets(const RasterInstance& instance, const Elite::FMatrix4& worldViewProj, const Camera* pCamera);
+		//Transforms every vertex of the visible meshlets into m_ProjectedVertices
+		void TransformVertices(const Mesh* pMesh, const Elite::FMatrix4& worldViewProj, const Camera* pCamera);
+		static bool IsBoxOutsideFrustum(const Elite::FPoint3& boundsMin, const Elite::FPoint3& boundsMax, const Elite::FMatrix4& worldViewProj, const Camera* pCamera);
 
 		SDL_Window* m_pWindow;
 		uint32_t m_Width;
 		uint32_t m_Height;
 
 		bool m_useDirectX = true;
+		bool m_IsEventDriven = false;
+		//Renderer state changed, e.g. the rasterizer was swapped
+		bool m_IsDirty = true;
 
 		//Rasterizer
+		//Only used by the rendering thread
 		SDL_Surface* m_pFrontBuffer = nullptr;
-		SDL_Surface* m_pBackBuffer = nullptr;
+		//Row major copy of the last detiled back buffer, written by the present thread and blitted to the window by the rendering thread
+		//Null when presenting directly
+		SDL_Surface* m_pPresentSurface = nullptr;
+		bool m_IsPresentingDirectly = false;
+		//Frame i is rendered into m_BackBuffers[i % m_BackBuffers.size()], a back buffer is free again once it is detiled
+		std::vector<BackBuffer> m_BackBuffers;
+		//The back buffer that is rendered into
+		BackBuffer* m_pBackBuffer = nullptr;
 		uint32_t* m_pBackBufferPixels = nullptr;
-		float* m_pDepthBuffer = nullptr;
+		DepthBuffer* m_pDepthBuffer = nullptr;
+		//Color and depth of the static meshes only, from the last frame that built it
+		BackBuffer m_StaticLayer{};
+		DepthBuffer* m_pStaticLayerDepth = nullptr;
+		//Set when a frame that builds the static layer is submitted, frames submitted after it are rasterized after it as well
+		bool m_HasStaticLayer = false;
+		//The static meshes in the layer, a mesh that stops or starts being static changes the layer too
+		std::vector<const Mesh*> m_StaticLayerMeshes;
+		//Temporal reprojection, the opaque color and depth of the last rasterized frame
+		bool m_UseTemporalReprojection = false;
+		bool m_HasHistory = false;
+		BackBuffer m_History{};
+		DepthBuffer* m_pHistoryDepth = nullptr;
+		//From the clip space of this frame to the clip space of the history
+		Elite::FMatrix4 m_Reprojection{};
+		Elite::FMatrix4 m_HistoryViewProj{};
+		//Turns the depth of the history back into a distance, distance = scale / (depth - offset)
+		float m_HistoryDepthScale = 0.f;
+		float m_HistoryDepthOffset = 0.f;
+		uint32_t m_TemporalFrame = 0;
+		static const uint32_t m_RefreshPeriod{ 8 };
+		//Relative difference in distance up to which the history holds the same surface
+		static constexpr float m_ReprojectionTolerance{ 0.01f };
+
+		//Variable rate shading
+		bool m_UseVariableRateShading = false;
+		std::vector<ShadingRate> m_ShadingRateImage;
+		//Rate of every tile for the frame that is rasterized
+		std::vector<ShadingRate> m_TileShadingRates;
+		//Opaque pass, colors shaded for the blocks of the current triangle, counted in 2x2 pixels, valid when their stamp is the current one
+		std::vector<uint32_t> m_CoarseColors;
+		std::vector<uint32_t> m_CoarseStamps;
+		uint32_t m_CoarseStamp = 0;
+		//Fractions of half the screen diagonal, tiles closer to the middle than the first are shaded at full rate, tiles beyond the second at 4x4
+		static constexpr float m_FovealRadius{ 0.5f };
+		static constexpr float m_PeripheralRadius{ 0.8f };
+		static constexpr float m_HalfRateDistance{ 60.f };
+		static constexpr float m_QuarterRateDistance{ 120.f };
+		//Weighted blended OIT, premultiplied RGB and alpha summed with their weights, 4 floats per pixel
+		TiledBuffer* m_pAccumulation = nullptr;
+		//Product of (1 - alpha) of every order independent fragment, the fraction of the background that stays visible
+		TiledBuffer* m_pRevealage = nullptr;
+		//Output of the transform pass, positions are divided by w, only used by the geometry thread
+		struct ProjectedVertices
+		{
+			std::vector<float> X;
+			std::vector<float> Y;
+			std::vector<float> Z;
+			std::vector<float> W;
+			std::vector<uint8_t> IsCulled;
+			//A vertex is transformed for the current instance when its stamp is Stamp
+			std::vector<uint32_t> Stamps;
+			uint32_t Stamp = 0;
+		};
+		ProjectedVertices m_ProjectedVertices;
+		std::vector<uint32_t> m_VisibleMeshlets;
+
+		//Frame i uses m_Frames[i % m_Frames.size()], a frame is free again once it is rasterized
+		std::vector<Frame> m_Frames;
+		//Guarded by m_FrameMutex, m_SubmittedFrames and m_RasterizedFrames are only written by the rendering thread
+		uint64_t m_SubmittedFrames = 0;
+		uint64_t m_ProcessedFrames = 0;
+		uint64_t m_RasterizedFrames = 0;
+		//Written by the present thread, m_pPresentSurface holds frame m_DetiledFrames - 1 while it is ahead of m_PresentedFrames
+		uint64_t m_DetiledFrames = 0;
+		//Written by the rendering thread
+		uint64_t m_PresentedFrames = 0;
+		bool m_IsStopping = false;
+		std::mutex m_FrameMutex;
+		std::condition_variable m_FrameCondition;
+		std::thread m_GeometryThread;
+		std::thread m_PresentThread;
+
+		//Tile threads, ResolveTransparency hands them the tiles of a frame and waits until they are all done with it
+		//Guarded by m_TileMutex, except for m_NextTile
+		uint64_t m_TileJobs = 0;
+		uint32_t m_FinishedTileThreads = 0;
+		bool m_AreTileThreadsStopping = false;
+		const Frame* m_pTileFrame = nullptr;
+		//RasterizeTransparentTile of the depth format of the frame
+		void (Renderer::*m_pRasterizeTile)(uint32_t, const Frame&, TileShadingCache&) = nullptr;
+		std::atomic<uint32_t> m_NextTile{ 0 };
+		std::mutex m_TileMutex;
+		std::condition_variable m_TileCondition;
+		std::vector<std::thread> m_TileThreads;
+		//Cache 0 belongs to the rendering thread, cache i + 1 to tile thread i
+		std::vector<TileShadingCache> m_TileShadingCaches;
+
+		//Indices of the transparent triangles that overlap every tile
+		std::vector<std::vector<uint32_t>> m_TileTriangles;
+		static const uint32_t m_TileSize{ 64 };
+		uint32_t m_AmountOfTilesX;
+		uint32_t m_AmountOfTilesY;
+		uint32_t m_AmountOfThreads;
 
 		//DirectX
 		bool m_IsInitialized;
+		std::vector<D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS> m_Draws;
 
 		ID3D11Device* m_pDevice = nullptr;
 		ID3D11DeviceContext* m_pDeviceContext = nullptr;
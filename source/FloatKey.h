@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//Hash map key of a fixed amount of floats, two keys are equal when all their bits are, with -0 folded into +0
+//Used to weld vertices and positions that are exactly the same, values that differ in their last bits stay apart
+template<size_t Size>
+struct FloatKey
+{
+	float values[Size];
+
+	//Adding 0 turns every -0 into 0, they compare equal as floats but would hash differently
+	FloatKey(const float (&keyValues)[Size])
+	{
+		for (size_t i = 0; i < Size; i++) values[i] = keyValues[i] + 0.f;
+	}
+	bool operator==(const FloatKey& other) const
+	{
+		return std::memcmp(values, other.values, sizeof(values)) == 0;
+	}
+
+	struct Hash
+	{
+		//FNV-1a over the raw bits of the values
+		size_t operator()(const FloatKey& key) const
+		{
+			uint32_t bits[Size]{};
+			std::memcpy(bits, key.values, sizeof(bits));
+
+			size_t hash{ 14695981039346656037ull };
+			for (uint32_t value : bits)
+			{
+				hash ^= value;
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	};
+};
@@ -0,0 +1,46 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const std::string& filePath)
+{
+	m_File = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(m_File, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	//Mapping a file of size 0 is not allowed, an empty file simply stays "not open"
+	m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_Mapping == nullptr)
+		return;
+
+	m_pData = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_pData == nullptr)
+		return;
+
+	m_Size = size_t(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_Mapping) CloseHandle(m_Mapping);
+	if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+}
+
+bool MappedFile::IsOpen() const
+{
+	return m_pData != nullptr;
+}
+
+const char* MappedFile::GetData() const
+{
+	return m_pData;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_Size;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+
+//Read-only view of a file, mapped into memory by the OS instead of being copied into a buffer
+class MappedFile final
+{
+public:
+	MappedFile(const std::string& filePath);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&&) = delete;
+	MappedFile& operator=(MappedFile&&) = delete;
+	~MappedFile();
+
+	bool IsOpen() const;
+	const char* GetData() const;
+	size_t GetSize() const;
+private:
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = nullptr;
+	const char* m_pData = nullptr;
+	size_t m_Size = 0;
+};
+
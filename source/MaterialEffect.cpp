@@ -1,13 +1,9 @@
 #include "pch.h"
 #include "MaterialEffect.h"
 
-MaterialEffect::MaterialEffect(ID3D11Device* pDevice, const std::string& shaderPath)
-	: BaseEffect{pDevice, shaderPath}
+MaterialEffect::MaterialEffect(ID3D11Device* pDevice, const std::string& shaderPath, const D3D_SHADER_MACRO* pDefines)
+	: BaseEffect{pDevice, shaderPath, pDefines}
 {
-	m_pMatWorldVariable = m_pEffect->GetVariableByName("gWorld")->AsMatrix();
-	if (!m_pMatWorldVariable->IsValid())
-		std::cout << "m_pMatWorldVariable not valid!" << '\n';
-
 	m_pMatViewInverseVariable = m_pEffect->GetVariableByName("gViewInverse")->AsMatrix();
 	if (!m_pMatViewInverseVariable->IsValid())
 		std::cout << "m_pMatViewInverseVariable not valid!" << '\n';
@@ -35,16 +31,9 @@ MaterialEffect::~MaterialEffect()
 	m_pNormalMapVariable->Release();
 	m_pSpecularMapVariable->Release();
 	m_pGlossinessMapVariable->Release();
-	m_pMatWorldVariable->Release();
 	m_pMatViewInverseVariable->Release();
 }
 
-void MaterialEffect::SetWorldMatrix(const Elite::FMatrix4& world)
-{
-	const float* firstElement{ world.data[0] };
-	m_pMatWorldVariable->SetMatrix(firstElement);
-}
-
 void MaterialEffect::SetViewInverseMatrix(const Elite::FMatrix4& viewInverse)
 {
 	const float* firstElement{ viewInverse.data[0] };
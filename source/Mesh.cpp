@@ -2,6 +2,11 @@
 #include "Mesh.h"
 #include "TransparantEffect.h"
 #include "MaterialEffect.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
 
 Mesh::Vertex_Input::Vertex_Input(const Elite::FPoint3& position, const Elite::FVector2& uv, const Elite::FVector3& normal, const Elite::FVector3& tangent)
 	: Position{position}
@@ -27,100 +32,86 @@ bool Mesh::Vertex_Input::operator==(const Vertex_Input& other) const
 }
 
 Mesh::Mesh(const std::vector<Vertex_Input>& vertices, const std::vector<uint32_t>& indices, ID3D11Device* pDevice, bool canGoTransparant, bool canSwitchCullMode
-		, const std::string& shaderPath, const Elite::FMatrix4& worldMatrix)
-	: m_World{worldMatrix}
+		, const std::string& shaderPath, const Elite::FMatrix4& worldMatrix, const VertexFormat& vertexFormat, const std::vector<uint32_t>& submeshStarts)
+	: m_Instances{ Instance{ worldMatrix, Elite::RGBColor{ 1.f, 1.f, 1.f }, 0 } }
+	, m_ShaderPath{ shaderPath }
 	, m_CanGoTransparant{canGoTransparant}
+	, m_CanReorderTriangles{ !canGoTransparant }
 	, m_CanSwitchCullMode{canSwitchCullMode}
-	, m_VertexBuffer{vertices}
-	, m_IndexBuffer{indices}
+	, m_VertexFormat{vertexFormat}
+	, m_AmountVertices{(uint32_t)vertices.size()}
+	, m_IndexFormat{ vertices.size() <= 0x10000 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT }
 {
-	if (canGoTransparant) m_pEffect = new TransparantEffect(pDevice, shaderPath);
-	else m_pEffect = new MaterialEffect(pDevice, shaderPath);
+	//The shaders only read the attributes the format defines
+	const std::vector<D3D_SHADER_MACRO> defines{ m_VertexFormat.GetShaderDefines() };
+	if (canGoTransparant) m_pEffect = new TransparantEffect(pDevice, shaderPath, defines.data());
+	else m_pEffect = new MaterialEffect(pDevice, shaderPath, defines.data());
+
+	if (m_VertexFormat.IsCompact())
+	{
+		CalculateCompactBounds(vertices);
+		m_pEffect->SetVertexDecode(Elite::FVector4{ m_PositionScale }, Elite::FVector4{ Elite::FVector3{ m_PositionOffset } },
+			Elite::FVector4{ m_UVScale.x, m_UVScale.y, m_UVOffset.x, m_UVOffset.y });
+	}
+	PackVertices(vertices);
+	FillPositionStreams();
+
+	CalculateSubmeshBounds(indices, submeshStarts);
+	std::vector<uint32_t> lodIndices{ BuildLods(indices, submeshStarts) };
+	m_LodInstanceOffsets.assign(m_Lods.size() + 1, 0);
+	if (m_IndexFormat == DXGI_FORMAT_R16_UINT) m_IndexBuffer16.assign(lodIndices.begin(), lodIndices.end());
+	else m_IndexBuffer32.swap(lodIndices);
 
 	if (!canSwitchCullMode) m_pEffect->SetCullMode(BaseEffect::EffectCullMode::None);
 
-	//Create Vertex Layout
+	//Create the input layout, one element per attribute in the format
 	HRESULT result = S_OK;
-	static const uint32_t numElements{ 5 };
-	D3D11_INPUT_ELEMENT_DESC vertexDesc[numElements]{};
-
-	vertexDesc[0].SemanticName = "POSITION";
-	vertexDesc[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	vertexDesc[0].AlignedByteOffset = 0;
-	vertexDesc[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
-	vertexDesc[1].SemanticName = "COLOR";
-	vertexDesc[1].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	//Offset is 12 = 3(x,y,z) * 4(sizeof(float)) = Position
-	vertexDesc[1].AlignedByteOffset = 12;
-	vertexDesc[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
-	vertexDesc[2].SemanticName = "TEXCOORD";
-	vertexDesc[2].Format = DXGI_FORMAT_R32G32_FLOAT;
-	//Offset: 3(x,y,z) * 4(sizeof(float)) + 3(r,g,b) * 4(sizeof(float)) = 24
-	vertexDesc[2].AlignedByteOffset = 24;
-	vertexDesc[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
-	vertexDesc[3].SemanticName = "NORMAL";
-	vertexDesc[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	//Offset: 3(x,y,z) * 4(sizeof(float)) + 3(r,g,b) * 4(sizeof(float)) + 2(x,y) * 4(sizeof(float))= 32
-	vertexDesc[3].AlignedByteOffset = 32;
-	vertexDesc[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
-	vertexDesc[4].SemanticName = "TANGENT";
-	vertexDesc[4].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	//Offset: 3(x,y,z) * 4(sizeof(float)) + 3(r,g,b) * 4(sizeof(float)) + 2(x,y) * 4(sizeof(float)) + 3(x,y,z) * 4(sizeof(float))= 44
-	vertexDesc[4].AlignedByteOffset = 44;
-	vertexDesc[4].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
-	//Create the input layout
+	const std::vector<D3D11_INPUT_ELEMENT_DESC> vertexDesc{ m_VertexFormat.GetInputElements() };
 	D3DX11_PASS_DESC passDesc{};
 	m_pEffect->GetTechnique()->GetPassByIndex(0)->GetDesc(&passDesc);
 	result = pDevice->CreateInputLayout(
-		vertexDesc,
-		numElements,
+		vertexDesc.data(),
+		(uint32_t)vertexDesc.size(),
 		passDesc.pIAInputSignature,
 		passDesc.IAInputSignatureSize,
 		&m_pVertexLayout
 	);
 	if (FAILED(result))
+	{
+		std::cout << "Vertex format of " << shaderPath << " not valid!" << '\n';
 		return;
+	}
 
 	//Create vertex buffer
 	D3D11_BUFFER_DESC bufferDesc{};
 	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-	bufferDesc.ByteWidth = sizeof(Vertex_Input) * (uint32_t)vertices.size();
+	bufferDesc.ByteWidth = (uint32_t)m_VertexBuffer.size();
 	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	bufferDesc.CPUAccessFlags = 0;
 	bufferDesc.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA initData{ 0 };
-	initData.pSysMem = vertices.data();
+	initData.pSysMem = m_VertexBuffer.data();
 	result = pDevice->CreateBuffer(&bufferDesc, &initData, &m_pVertexBuffer);
 	if (FAILED(result))
 		return;
 
 	//Create index buffer (reuses Buffer Description and initData from VertexBuffer)
-	m_AmountIndices = (uint32_t)indices.size();
+	m_AmountIndices = uint32_t(m_IndexFormat == DXGI_FORMAT_R16_UINT ? m_IndexBuffer16.size() : m_IndexBuffer32.size());
 	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-	bufferDesc.ByteWidth = sizeof(uint32_t) * m_AmountIndices;
+	bufferDesc.ByteWidth = (m_IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t)) * m_AmountIndices;
 	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	bufferDesc.CPUAccessFlags = 0;
 	bufferDesc.MiscFlags = 0;
-	initData.pSysMem = indices.data();
+	if (m_IndexFormat == DXGI_FORMAT_R16_UINT) initData.pSysMem = m_IndexBuffer16.data();
+	else initData.pSysMem = m_IndexBuffer32.data();
 	result = pDevice->CreateBuffer(&bufferDesc, &initData, &m_pIndexBuffer);
 	if (FAILED(result))
 		return;
-
-	for (size_t i = 0; i < m_VertexBuffer.size(); i++)
-	{
-		m_VertexBuffer[i].Tangent *= -1;
-		m_VertexBuffer[i].Position.z *= -1;
-		m_VertexBuffer[i].Normal.z *= -1;
-	}
 }
 
 Mesh::~Mesh()
 {
+	if (m_pInstanceBuffer) m_pInstanceBuffer->Release();
 	m_pIndexBuffer->Release();
 	m_pVertexBuffer->Release();
 	m_pVertexLayout->Release();
@@ -134,30 +125,222 @@ Mesh::~Mesh()
 
 void Mesh::Update(const Camera* pCamera)
 {
-	m_WorldViewProj = pCamera->GetProjection() * pCamera->GetView() * m_World;
+	const Elite::FMatrix4 viewProj{ pCamera->GetProjection() * pCamera->GetView() };
+	for (Instance& instance : m_Instances) instance.Lod = SelectLod(instance, viewProj, pCamera);
 
-	m_pEffect->SetWorldViewProjMatrix(m_WorldViewProj);
+	m_pEffect->SetViewProjMatrix(viewProj);
 	if (!m_CanGoTransparant)
 	{
 		MaterialEffect* pMaterialEffect = reinterpret_cast<MaterialEffect*>(m_pEffect);
-		pMaterialEffect->SetWorldMatrix(m_World);
 		pMaterialEffect->SetViewInverseMatrix(pCamera->GetONB());
 	}
 }
 
+void Mesh::UploadInstances(ID3D11DeviceContext* pDeviceContext)
+{
+	//Counting sort on the LOD, every LOD gets a consecutive range of instances
+	std::fill(m_LodInstanceOffsets.begin(), m_LodInstanceOffsets.end(), 0);
+	for (const Instance& instance : m_Instances) m_LodInstanceOffsets[instance.Lod + 1]++;
+	std::partial_sum(m_LodInstanceOffsets.begin(), m_LodInstanceOffsets.end(), m_LodInstanceOffsets.begin());
+
+	m_InstanceData.resize(m_Instances.size());
+	m_LodInstanceIndices.resize(m_Instances.size());
+	std::vector<uint32_t> fillOffsets(m_LodInstanceOffsets.begin(), m_LodInstanceOffsets.end() - 1);
+	for (uint32_t i = 0; i < m_Instances.size(); i++)
+	{
+		const Instance& instance{ m_Instances[i] };
+		const uint32_t slot{ fillOffsets[instance.Lod]++ };
+		m_LodInstanceIndices[slot] = i;
+		InstanceData& data{ m_InstanceData[slot] };
+		std::memcpy(data.World, instance.World.data, sizeof(data.World));
+		data.Tint[0] = instance.Tint.r;
+		data.Tint[1] = instance.Tint.g;
+		data.Tint[2] = instance.Tint.b;
+		data.Tint[3] = 1.f;
+	}
+
+	//The buffer grows by doubling, so adding instances one at a time doesn't recreate it every frame
+	if (m_InstanceCapacity < m_Instances.size())
+	{
+		if (m_pInstanceBuffer) m_pInstanceBuffer->Release();
+		m_pInstanceBuffer = nullptr;
+		m_InstanceCapacity = std::max(uint32_t(m_Instances.size()), m_InstanceCapacity * 2);
+
+		ID3D11Device* pDevice = nullptr;
+		pDeviceContext->GetDevice(&pDevice);
+		D3D11_BUFFER_DESC bufferDesc{};
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.ByteWidth = sizeof(InstanceData) * m_InstanceCapacity;
+		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0;
+		HRESULT result = pDevice->CreateBuffer(&bufferDesc, nullptr, &m_pInstanceBuffer);
+		pDevice->Release();
+		if (FAILED(result))
+		{
+			m_InstanceCapacity = 0;
+			std::cout << "m_pInstanceBuffer not valid!" << '\n';
+			return;
+		}
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource{};
+	if (FAILED(pDeviceContext->Map(m_pInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+		return;
+	std::memcpy(mappedResource.pData, m_InstanceData.data(), sizeof(InstanceData) * m_InstanceData.size());
+	pDeviceContext->Unmap(m_pInstanceBuffer, 0);
+}
+
+uint32_t Mesh::AddInstance(const Elite::FMatrix4& world, const Elite::RGBColor& tint)
+{
+	m_Instances.push_back(Instance{ world, tint, 0 });
+	m_IsDirty = true;
+	return uint32_t(m_Instances.size() - 1);
+}
+
+void Mesh::SetInstance(uint32_t index, const Elite::FMatrix4& world, const Elite::RGBColor& tint)
+{
+	m_Instances[index].World = world;
+	m_Instances[index].Tint = tint;
+	m_IsDirty = true;
+}
+
 const Elite::FMatrix4& Mesh::GetWorldMatrix() const
 {
-	return m_World;
+	return m_Instances[0].World;
+}
+
+const std::vector<Mesh::Instance>& Mesh::GetInstances() const
+{
+	return m_Instances;
+}
+
+Mesh::Vertex_Input Mesh::GetVertex(uint32_t index) const
+{
+	const uint8_t* pVertex{ m_VertexBuffer.data() + size_t(index) * m_VertexFormat.GetStride() };
+	Vertex_Input vertex{};
+
+	if (m_VertexFormat.IsCompact())
+	{
+		uint16_t position[4]{};
+		std::memcpy(position, pVertex + m_VertexFormat.GetOffset(VertexFormat::Position), sizeof(position));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			vertex.Position.data[axis] = m_PositionOffset.data[axis] + position[axis] / 65535.f * m_PositionScale.data[axis];
+		}
+		if (m_VertexFormat.Has(VertexFormat::Color))
+		{
+			const uint8_t* pColor{ pVertex + m_VertexFormat.GetOffset(VertexFormat::Color) };
+			vertex.Color = Elite::RGBColor{ pColor[0] / 255.f, pColor[1] / 255.f, pColor[2] / 255.f };
+		}
+		if (m_VertexFormat.Has(VertexFormat::UV))
+		{
+			uint16_t uv[2]{};
+			std::memcpy(uv, pVertex + m_VertexFormat.GetOffset(VertexFormat::UV), sizeof(uv));
+			vertex.UV.x = m_UVOffset.x + uv[0] / 65535.f * m_UVScale.x;
+			vertex.UV.y = m_UVOffset.y + uv[1] / 65535.f * m_UVScale.y;
+		}
+		int16_t encoded[2]{};
+		if (m_VertexFormat.Has(VertexFormat::Normal))
+		{
+			std::memcpy(encoded, pVertex + m_VertexFormat.GetOffset(VertexFormat::Normal), sizeof(encoded));
+			vertex.Normal = DecodeOctahedral(encoded);
+		}
+		if (m_VertexFormat.Has(VertexFormat::Tangent))
+		{
+			std::memcpy(encoded, pVertex + m_VertexFormat.GetOffset(VertexFormat::Tangent), sizeof(encoded));
+			vertex.Tangent = DecodeOctahedral(encoded);
+		}
+	}
+	else
+	{
+		std::memcpy(&vertex.Position, pVertex + m_VertexFormat.GetOffset(VertexFormat::Position), sizeof(vertex.Position));
+		if (m_VertexFormat.Has(VertexFormat::Color)) std::memcpy(&vertex.Color, pVertex + m_VertexFormat.GetOffset(VertexFormat::Color), sizeof(vertex.Color));
+		if (m_VertexFormat.Has(VertexFormat::UV)) std::memcpy(&vertex.UV, pVertex + m_VertexFormat.GetOffset(VertexFormat::UV), sizeof(vertex.UV));
+		if (m_VertexFormat.Has(VertexFormat::Normal)) std::memcpy(&vertex.Normal, pVertex + m_VertexFormat.GetOffset(VertexFormat::Normal), sizeof(vertex.Normal));
+		if (m_VertexFormat.Has(VertexFormat::Tangent)) std::memcpy(&vertex.Tangent, pVertex + m_VertexFormat.GetOffset(VertexFormat::Tangent), sizeof(vertex.Tangent));
+	}
+
+	//The packed vertices are shared with the GPU, the rasterizer works with z and the tangent flipped
+	vertex.Tangent *= -1;
+	vertex.Position.z *= -1;
+	vertex.Normal.z *= -1;
+	return vertex;
+}
+
+uint32_t Mesh::GetAmountOfVertices() const
+{
+	return m_AmountVertices;
+}
+
+const VertexFormat& Mesh::GetVertexFormat() const
+{
+	return m_VertexFormat;
+}
+
+const Mesh::PositionStreams& Mesh::GetPositionStreams() const
+{
+	return m_PositionStreams;
+}
+
+const std::vector<Mesh::Meshlet>& Mesh::GetMeshlets() const
+{
+	return m_Meshlets;
+}
+
+const std::vector<uint32_t>& Mesh::GetMeshletVertices() const
+{
+	return m_MeshletVertices;
+}
+
+const std::vector<Mesh::Lod>& Mesh::GetLods() const
+{
+	return m_Lods;
+}
+
+const std::vector<Mesh::Submesh>& Mesh::GetSubmeshes() const
+{
+	return m_Submeshes;
+}
+
+const Mesh::Lod& Mesh::GetSubmeshLod(uint32_t lod, uint32_t submesh) const
+{
+	return m_SubmeshLods[lod * m_Submeshes.size() + submesh];
+}
+
+const std::vector<uint32_t>& Mesh::GetLodInstanceOffsets() const
+{
+	return m_LodInstanceOffsets;
+}
+
+const Mesh::Instance& Mesh::GetLodInstance(uint32_t index) const
+{
+	return m_Instances[m_LodInstanceIndices[index]];
+}
+
+const Elite::FPoint3& Mesh::GetBoundsMin() const
+{
+	return m_BoundsMin;
+}
+
+const Elite::FPoint3& Mesh::GetBoundsMax() const
+{
+	return m_BoundsMax;
+}
+
+const std::vector<uint16_t>& Mesh::GetIndexBuffer16() const
+{
+	return m_IndexBuffer16;
 }
 
-const std::vector<Mesh::Vertex_Input>& Mesh::GetVertexBuffer() const
+const std::vector<uint32_t>& Mesh::GetIndexBuffer32() const
 {
-	return m_VertexBuffer;
+	return m_IndexBuffer32;
 }
 
-const std::vector<uint32_t>& Mesh::GetIndexBuffer() const
+DXGI_FORMAT Mesh::GetIndexFormat() const
 {
-	return m_IndexBuffer;
+	return m_IndexFormat;
 }
 
 ID3D11Buffer* Mesh::GetVertexBufferGPU() const
@@ -170,6 +353,16 @@ ID3D11Buffer* Mesh::GetIndexBufferGPU() const
 	return m_pIndexBuffer;
 }
 
+ID3D11Buffer* Mesh::GetInstanceBufferGPU() const
+{
+	return m_pInstanceBuffer;
+}
+
+uint32_t Mesh::GetInstanceStride() const
+{
+	return sizeof(InstanceData);
+}
+
 int Mesh::GetAmountOfIndices() const
 {
 	return m_AmountIndices;
@@ -185,6 +378,28 @@ const BaseEffect* Mesh::GetEffect() const
 	return m_pEffect;
 }
 
+const std::string& Mesh::GetShaderPath() const
+{
+	return m_ShaderPath;
+}
+
+bool Mesh::HasSameMaterial(const Mesh* pOther) const
+{
+	const auto isSameTexture = [](const Texture* pTexture, const Texture* pOtherTexture)
+	{
+		if (!pTexture || !pOtherTexture) return pTexture == pOtherTexture;
+		return pTexture->GetPath() == pOtherTexture->GetPath();
+	};
+	return m_ShaderPath == pOther->m_ShaderPath
+		&& m_CanGoTransparant == pOther->m_CanGoTransparant
+		&& m_CanSwitchCullMode == pOther->m_CanSwitchCullMode
+		&& m_VertexFormat.GetAttributes() == pOther->m_VertexFormat.GetAttributes()
+		&& isSameTexture(m_pDiffuse, pOther->m_pDiffuse)
+		&& isSameTexture(m_pNormal, pOther->m_pNormal)
+		&& isSameTexture(m_pGlossiness, pOther->m_pGlossiness)
+		&& isSameTexture(m_pSpecular, pOther->m_pSpecular);
+}
+
 const Texture* Mesh::GetDiffuse() const
 {
 	return m_pDiffuse;
@@ -215,6 +430,19 @@ bool Mesh::CanGoTransparant() const
 	return m_CanGoTransparant;
 }
 
+bool Mesh::CanReorderTriangles() const
+{
+	return m_CanReorderTriangles;
+}
+
+bool Mesh::IsTransparent() const
+{
+	if (!m_CanGoTransparant) return false;
+
+	const TransparantEffect* pEffect = reinterpret_cast<const TransparantEffect*>(m_pEffect);
+	return pEffect->IsTransparent();
+}
+
 bool Mesh::CanSwitchCullMode() const
 {
 	return m_CanSwitchCullMode;
@@ -222,13 +450,15 @@ bool Mesh::CanSwitchCullMode() const
 
 void Mesh::SetWorldMatrix(const Elite::FMatrix4& world)
 {
-	m_World = world;
+	m_Instances[0].World = world;
+	m_IsDirty = true;
 }
 
 void Mesh::SetDiffuseMap(const std::string& path, ID3D11Device* pDevice)
 {
 	if (m_pDiffuse) delete m_pDiffuse;
 	m_pDiffuse = new Texture(path, pDevice);
+	m_IsDirty = true;
 
 	if (m_CanGoTransparant)
 	{
@@ -246,6 +476,7 @@ void Mesh::SetNormalMap(const std::string& path, ID3D11Device* pDevice)
 {
 	if (m_pNormal) delete m_pNormal;
 	m_pNormal = new Texture(path, pDevice);
+	m_IsDirty = true;
 
 	if (!m_CanGoTransparant)
 	{
@@ -258,6 +489,7 @@ void Mesh::SetGlossinessMap(const std::string& path, ID3D11Device* pDevice)
 {
 	if (m_pGlossiness) delete m_pGlossiness;
 	m_pGlossiness = new Texture(path, pDevice);
+	m_IsDirty = true;
 
 	if (!m_CanGoTransparant)
 	{
@@ -270,6 +502,7 @@ void Mesh::SetSpecularMap(const std::string& path, ID3D11Device* pDevice)
 {
 	if (m_pSpecular) delete m_pSpecular;
 	m_pSpecular = new Texture(path, pDevice);
+	m_IsDirty = true;
 
 	if (!m_CanGoTransparant)
 	{
@@ -278,13 +511,42 @@ void Mesh::SetSpecularMap(const std::string& path, ID3D11Device* pDevice)
 	}
 }
 
+void Mesh::TakeTextures(Mesh* pSource)
+{
+	Texture** ppTextures[4]{ &m_pDiffuse, &m_pNormal, &m_pGlossiness, &m_pSpecular };
+	Texture** ppSourceTextures[4]{ &pSource->m_pDiffuse, &pSource->m_pNormal, &pSource->m_pGlossiness, &pSource->m_pSpecular };
+	for (int i = 0; i < 4; i++)
+	{
+		delete *ppTextures[i];
+		*ppTextures[i] = *ppSourceTextures[i];
+		*ppSourceTextures[i] = nullptr;
+	}
+	m_IsDirty = true;
+	pSource->m_IsDirty = true;
+
+	if (m_CanGoTransparant)
+	{
+		TransparantEffect* pEffect = reinterpret_cast<TransparantEffect*>(m_pEffect);
+		if (m_pDiffuse) pEffect->SetDiffuseMap(m_pDiffuse->GetTextureResourceView());
+		return;
+	}
+
+	MaterialEffect* pEffect = reinterpret_cast<MaterialEffect*>(m_pEffect);
+	if (m_pDiffuse) pEffect->SetDiffuseMap(m_pDiffuse->GetTextureResourceView());
+	if (m_pNormal) pEffect->SetNormalMap(m_pNormal->GetTextureResourceView());
+	if (m_pGlossiness) pEffect->SetGlossinessMap(m_pGlossiness->GetTextureResourceView());
+	if (m_pSpecular) pEffect->SetSpecularMap(m_pSpecular->GetTextureResourceView());
+}
+
 const BaseEffect::EffectSamplerState& Mesh::ChangeSamplerState()
 {
+	m_IsDirty = true;
 	return m_pEffect->ChangeSamplerState();
 }
 
 const BaseEffect::EffectCullMode& Mesh::ChangeCullMode()
 {
+	m_IsDirty = true;
 	return m_pEffect->ChangeCullMode();
 }
 
@@ -292,6 +554,314 @@ bool Mesh::ToggleTransparancy()
 {
 	if (!m_CanGoTransparant) return false;
 
+	m_IsDirty = true;
 	TransparantEffect* pEffect = reinterpret_cast<TransparantEffect*>(m_pEffect);
 	return pEffect->ToggleTransparancy();
 }
+
+bool Mesh::ToggleOrderIndependence()
+{
+	if (!m_CanGoTransparant) return false;
+
+	m_IsDirty = true;
+	TransparantEffect* pEffect = reinterpret_cast<TransparantEffect*>(m_pEffect);
+	return pEffect->ToggleOrderIndependence();
+}
+
+bool Mesh::IsOrderIndependent() const
+{
+	if (!m_CanGoTransparant) return false;
+
+	const TransparantEffect* pEffect = reinterpret_cast<const TransparantEffect*>(m_pEffect);
+	return pEffect->IsOrderIndependent();
+}
+
+void Mesh::SetStatic(bool isStatic)
+{
+	m_IsStatic = isStatic;
+	m_IsDirty = true;
+}
+
+bool Mesh::IsStatic() const
+{
+	return m_IsStatic;
+}
+
+bool Mesh::IsDirty() const
+{
+	return m_IsDirty;
+}
+
+void Mesh::ClearDirty()
+{
+	m_IsDirty = false;
+}
+
+void Mesh::PackVertices(const std::vector<Vertex_Input>& vertices)
+{
+	m_VertexBuffer.resize(vertices.size() * m_VertexFormat.GetStride());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex_Input& vertex{ vertices[i] };
+		uint8_t* pVertex{ m_VertexBuffer.data() + i * m_VertexFormat.GetStride() };
+
+		if (m_VertexFormat.IsCompact())
+		{
+			uint16_t position[4]{};
+			for (int axis = 0; axis < 3; axis++)
+			{
+				position[axis] = uint16_t(std::lround((vertex.Position.data[axis] - m_PositionOffset.data[axis]) / m_PositionScale.data[axis] * 65535.f));
+			}
+			std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::Position), position, sizeof(position));
+			if (m_VertexFormat.Has(VertexFormat::Color))
+			{
+				uint8_t color[4]{ uint8_t(std::lround(Elite::Clamp(vertex.Color.r, 0.f, 1.f) * 255.f)), uint8_t(std::lround(Elite::Clamp(vertex.Color.g, 0.f, 1.f) * 255.f)),
+					uint8_t(std::lround(Elite::Clamp(vertex.Color.b, 0.f, 1.f) * 255.f)), 255 };
+				std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::Color), color, sizeof(color));
+			}
+			if (m_VertexFormat.Has(VertexFormat::UV))
+			{
+				uint16_t uv[2]{};
+				for (int axis = 0; axis < 2; axis++)
+				{
+					uv[axis] = uint16_t(std::lround((vertex.UV.data[axis] - m_UVOffset.data[axis]) / m_UVScale.data[axis] * 65535.f));
+				}
+				std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::UV), uv, sizeof(uv));
+			}
+			int16_t encoded[2]{};
+			if (m_VertexFormat.Has(VertexFormat::Normal))
+			{
+				EncodeOctahedral(vertex.Normal, encoded);
+				std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::Normal), encoded, sizeof(encoded));
+			}
+			if (m_VertexFormat.Has(VertexFormat::Tangent))
+			{
+				EncodeOctahedral(vertex.Tangent, encoded);
+				std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::Tangent), encoded, sizeof(encoded));
+			}
+		}
+		else
+		{
+			std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::Position), &vertex.Position, sizeof(vertex.Position));
+			if (m_VertexFormat.Has(VertexFormat::Color)) std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::Color), &vertex.Color, sizeof(vertex.Color));
+			if (m_VertexFormat.Has(VertexFormat::UV)) std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::UV), &vertex.UV, sizeof(vertex.UV));
+			if (m_VertexFormat.Has(VertexFormat::Normal)) std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::Normal), &vertex.Normal, sizeof(vertex.Normal));
+			if (m_VertexFormat.Has(VertexFormat::Tangent)) std::memcpy(pVertex + m_VertexFormat.GetOffset(VertexFormat::Tangent), &vertex.Tangent, sizeof(vertex.Tangent));
+		}
+	}
+}
+
+void Mesh::FillPositionStreams()
+{
+	//Decoded from the packed vertices, so quantized positions match the ones the GPU sees
+	m_PositionStreams.X.resize(m_AmountVertices);
+	m_PositionStreams.Y.resize(m_AmountVertices);
+	m_PositionStreams.Z.resize(m_AmountVertices);
+	for (uint32_t i = 0; i < m_AmountVertices; i++)
+	{
+		const Elite::FPoint3 position{ GetVertex(i).Position };
+		m_PositionStreams.X[i] = position.x;
+		m_PositionStreams.Y[i] = position.y;
+		m_PositionStreams.Z[i] = position.z;
+	}
+
+	//Welding by exact position, the meshlet builder and the simplifier treat vertices on both sides of a seam as one
+	std::unordered_map<PositionKey, uint32_t, PositionKey::Hash> positionLookup{};
+	positionLookup.reserve(m_AmountVertices);
+	m_PositionStreams.WeldedIds.resize(m_AmountVertices);
+	for (uint32_t i = 0; i < m_AmountVertices; i++)
+	{
+		const PositionKey key{ { m_PositionStreams.X[i], m_PositionStreams.Y[i], m_PositionStreams.Z[i] } };
+		m_PositionStreams.WeldedIds[i] = positionLookup.emplace(key, i).first->second;
+	}
+
+	if (m_AmountVertices == 0) return;
+
+	//One contiguous pass per axis
+	const std::vector<float>* streams[3]{ &m_PositionStreams.X, &m_PositionStreams.Y, &m_PositionStreams.Z };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const auto bounds{ std::minmax_element(streams[axis]->begin(), streams[axis]->end()) };
+		m_BoundsMin.data[axis] = *bounds.first;
+		m_BoundsMax.data[axis] = *bounds.second;
+	}
+}
+
+void Mesh::CalculateSubmeshBounds(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& submeshStarts)
+{
+	m_Submeshes.resize(submeshStarts.size() + 1);
+	for (size_t submesh = 0; submesh < m_Submeshes.size(); submesh++)
+	{
+		const size_t first{ submesh == 0 ? 0 : submeshStarts[submesh - 1] };
+		const size_t last{ submesh == submeshStarts.size() ? indices.size() : submeshStarts[submesh] };
+		Elite::FPoint3 boundsMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Elite::FPoint3 boundsMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = first; i < last; i++)
+		{
+			const uint32_t vertex{ indices[i] };
+			const Elite::FPoint3 position{ m_PositionStreams.X[vertex], m_PositionStreams.Y[vertex], m_PositionStreams.Z[vertex] };
+			for (int axis = 0; axis < 3; axis++)
+			{
+				boundsMin.data[axis] = std::min(boundsMin.data[axis], position.data[axis]);
+				boundsMax.data[axis] = std::max(boundsMax.data[axis], position.data[axis]);
+			}
+		}
+		m_Submeshes[submesh] = Submesh{ boundsMin, boundsMax };
+	}
+}
+
+std::vector<uint32_t> Mesh::BuildLods(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& submeshStarts)
+{
+	std::vector<std::vector<uint32_t>> simplifiedIndices(m_Submeshes.size());
+	for (size_t submesh = 0; submesh < m_Submeshes.size(); submesh++)
+	{
+		const size_t first{ submesh == 0 ? 0 : submeshStarts[submesh - 1] };
+		const size_t last{ submesh == submeshStarts.size() ? indices.size() : submeshStarts[submesh] };
+		simplifiedIndices[submesh].assign(indices.begin() + first, indices.begin() + last);
+	}
+
+	std::vector<uint32_t> allIndices{};
+	float error{};
+	while (true)
+	{
+		Lod lod{ uint32_t(allIndices.size()), 0, uint32_t(m_Meshlets.size()), 0, error };
+		for (const std::vector<uint32_t>& submeshIndices : simplifiedIndices)
+		{
+			//Building the meshlets can reorder the triangles, so the indices are appended afterwards
+			std::vector<uint32_t> lodIndices{ submeshIndices };
+			std::vector<Meshlet> meshlets{};
+			std::vector<uint32_t> meshletVertices{};
+			MeshletBuilder::Build(m_PositionStreams, lodIndices, meshlets, meshletVertices, m_CanReorderTriangles);
+
+			const Lod submeshLod{ uint32_t(allIndices.size()), uint32_t(lodIndices.size()), uint32_t(m_Meshlets.size()), uint32_t(meshlets.size()), error };
+			for (Meshlet& meshlet : meshlets)
+			{
+				meshlet.FirstIndex += submeshLod.FirstIndex;
+				meshlet.FirstVertex += uint32_t(m_MeshletVertices.size());
+			}
+			m_Meshlets.insert(m_Meshlets.end(), meshlets.begin(), meshlets.end());
+			m_MeshletVertices.insert(m_MeshletVertices.end(), meshletVertices.begin(), meshletVertices.end());
+			allIndices.insert(allIndices.end(), lodIndices.begin(), lodIndices.end());
+			m_SubmeshLods.push_back(submeshLod);
+			lod.AmountIndices += submeshLod.AmountIndices;
+			lod.AmountMeshlets += submeshLod.AmountMeshlets;
+		}
+		m_Lods.push_back(lod);
+
+		//A simplified LOD has other triangles in another order, a blended mesh only has the one it was passed
+		if (!m_CanReorderTriangles || m_Lods.size() == m_MaxLods || lod.AmountIndices / 3 <= m_MinLodTriangles)
+			break;
+
+		//Every LOD is simplified from the previous one, so their errors add up
+		float lodError{};
+		size_t simplifiedSize{};
+		for (std::vector<uint32_t>& submeshIndices : simplifiedIndices)
+		{
+			lodError = std::max(lodError, MeshSimplifier::Simplify(m_PositionStreams, submeshIndices, size_t(submeshIndices.size() / 3 * m_LodReduction) * 3));
+			simplifiedSize += submeshIndices.size();
+		}
+		error += lodError;
+		//Stop when the simplifier got stuck, a LOD that barely saves anything isn't worth its memory
+		if (simplifiedSize > lod.AmountIndices * (1.f + m_LodReduction) / 2.f)
+			break;
+	}
+	return allIndices;
+}
+
+uint32_t Mesh::SelectLod(const Instance& instance, const Elite::FMatrix4& viewProj, const Camera* pCamera) const
+{
+	//Bounding sphere of the mesh, the bounds are in the rasterizer's space so z is flipped back
+	const Elite::FPoint3 center{ (m_BoundsMin.x + m_BoundsMax.x) / 2.f, (m_BoundsMin.y + m_BoundsMax.y) / 2.f, -(m_BoundsMin.z + m_BoundsMax.z) / 2.f };
+	const Elite::FMatrix4& world{ instance.World };
+	const float worldScale{ std::max(std::max(
+		Elite::Magnitude(Elite::FVector3{ world * Elite::FVector4{ 1.f, 0.f, 0.f, 0.f } }),
+		Elite::Magnitude(Elite::FVector3{ world * Elite::FVector4{ 0.f, 1.f, 0.f, 0.f } })),
+		Elite::Magnitude(Elite::FVector3{ world * Elite::FVector4{ 0.f, 0.f, 1.f, 0.f } })) };
+	const float radius{ Elite::Magnitude(m_BoundsMax - m_BoundsMin) / 2.f * worldScale };
+
+	//The error is projected at the front of the sphere, the closest any part of the mesh can be
+	const float distance{ (viewProj * (world * Elite::FPoint4{ center })).w - radius };
+	if (distance <= pCamera->GetNearPlane())
+		return 0;
+	const float pixelsPerUnit{ worldScale * pCamera->GetProjection()(1, 1) / distance * pCamera->GetScreenHeight() / 2.f };
+
+	uint32_t lod{ instance.Lod };
+	while (lod > 0 && m_Lods[lod].Error * pixelsPerUnit > m_LodPixelError * (1.f + m_LodHysteresis)) lod--;
+	while (lod + 1 < m_Lods.size() && m_Lods[lod + 1].Error * pixelsPerUnit < m_LodPixelError * (1.f - m_LodHysteresis)) lod++;
+	return lod;
+}
+
+void Mesh::CalculateCompactBounds(const std::vector<Vertex_Input>& vertices)
+{
+	//Bounds of the positions and uvs, the quantized values span exactly that range
+	Elite::FPoint3 minPosition{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Elite::FPoint3 maxPosition{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	Elite::FVector2 minUV{ FLT_MAX, FLT_MAX };
+	Elite::FVector2 maxUV{ -FLT_MAX, -FLT_MAX };
+	for (const Vertex_Input& vertex : vertices)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			minPosition.data[axis] = std::min(minPosition.data[axis], vertex.Position.data[axis]);
+			maxPosition.data[axis] = std::max(maxPosition.data[axis], vertex.Position.data[axis]);
+		}
+		for (int axis = 0; axis < 2; axis++)
+		{
+			minUV.data[axis] = std::min(minUV.data[axis], vertex.UV.data[axis]);
+			maxUV.data[axis] = std::max(maxUV.data[axis], vertex.UV.data[axis]);
+		}
+	}
+	if (vertices.empty()) return;
+
+	//A flat axis still needs a non-zero scale to divide by
+	m_PositionOffset = minPosition;
+	m_PositionScale = maxPosition - minPosition;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (m_PositionScale.data[axis] <= 0.f) m_PositionScale.data[axis] = 1.f;
+	}
+	m_UVOffset = minUV;
+	m_UVScale = maxUV - minUV;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (m_UVScale.data[axis] <= 0.f) m_UVScale.data[axis] = 1.f;
+	}
+}
+
+void Mesh::EncodeOctahedral(const Elite::FVector3& direction, int16_t encoded[2])
+{
+	//Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper half
+	//https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+	const float length{ abs(direction.x) + abs(direction.y) + abs(direction.z) };
+	if (!(length > 0.f))
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float x{ direction.x / length };
+	float y{ direction.y / length };
+	if (direction.z < 0.f)
+	{
+		const float foldedX{ (1.f - abs(y)) * (x >= 0.f ? 1.f : -1.f) };
+		const float foldedY{ (1.f - abs(x)) * (y >= 0.f ? 1.f : -1.f) };
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = int16_t(std::lround(Elite::Clamp(x, -1.f, 1.f) * 32767.f));
+	encoded[1] = int16_t(std::lround(Elite::Clamp(y, -1.f, 1.f) * 32767.f));
+}
+
+Elite::FVector3 Mesh::DecodeOctahedral(const int16_t encoded[2])
+{
+	Elite::FVector3 direction{ std::max(encoded[0] / 32767.f, -1.f), std::max(encoded[1] / 32767.f, -1.f), 0.f };
+	direction.z = 1.f - abs(direction.x) - abs(direction.y);
+
+	const float fold{ Elite::Clamp(-direction.z, 0.f, 1.f) };
+	direction.x += direction.x >= 0.f ? -fold : fold;
+	direction.y += direction.y >= 0.f ? -fold : fold;
+
+	return Elite::GetNormalized(direction);
+}
@@ -2,8 +2,10 @@
 #include "pch.h"
 #include <vector>
 #include "Camera.h"
+#include "FloatKey.h"
 #include "BaseEffect.h"
 #include "Texture.h"
+#include "VertexFormat.h"
 
 class Mesh final
 {
@@ -21,27 +23,122 @@ public:
 		bool operator==(const Vertex_Input& other) const;
 	};
 
+	//Positions of all vertices as separate x, y and z arrays, in the rasterizer's space
+	//Passes that only need positions (transform, culling, bounds) read these instead of unpacking whole vertices
+	struct PositionStreams
+	{
+		std::vector<float> X;
+		std::vector<float> Y;
+		std::vector<float> Z;
+		//Id of the first vertex with the same position, vertices that are split along uv or normal seams share it
+		std::vector<uint32_t> WeldedIds;
+	};
+
+	//Group of neighbouring triangles the software rasterizer culls as a whole, built by MeshletBuilder
+	//Covers indices [FirstIndex, FirstIndex + AmountIndices) of the index buffer, the vertices they use are listed in GetMeshletVertices()
+	struct Meshlet
+	{
+		uint32_t FirstIndex;
+		uint32_t AmountIndices;
+		uint32_t FirstVertex;
+		uint32_t AmountVertices;
+
+		//Bounding sphere, in the rasterizer's space
+		Elite::FPoint3 Center;
+		float Radius;
+		//Normal cone: every triangle normal is within the cone around ConeAxis, ConeCutoff is the sine of its half angle
+		//ConeCutoff is 1 when the normals spread too far for the cone to reject anything
+		Elite::FVector3 ConeAxis;
+		float ConeCutoff;
+	};
+
+	//Simplified version of the mesh built by MeshSimplifier, LOD 0 is the full mesh
+	//Covers indices [FirstIndex, FirstIndex + AmountIndices) and meshlets [FirstMeshlet, FirstMeshlet + AmountMeshlets), all LODs share the vertices
+	struct Lod
+	{
+		uint32_t FirstIndex;
+		uint32_t AmountIndices;
+		uint32_t FirstMeshlet;
+		uint32_t AmountMeshlets;
+		//How far the simplified surface may be away from the original one, in object space
+		float Error;
+	};
+
+	//Part of the mesh that is culled on its own, a StaticBatch has one per mesh it merged, other meshes are a single submesh
+	struct Submesh
+	{
+		//Object space bounding box, in the rasterizer's space
+		Elite::FPoint3 BoundsMin;
+		Elite::FPoint3 BoundsMax;
+	};
+
+	//Every instance draws the same geometry, effect and textures with its own world matrix and tint
+	struct Instance
+	{
+		Elite::FMatrix4 World;
+		Elite::RGBColor Tint;
+		//Selected by the last Update, from the size of the mesh on screen
+		uint32_t Lod;
+	};
+
+	//Vertices are stored packed as described by vertexFormat, on the CPU as well as on the GPU
+	//Attributes that are not in the format are dropped, GetVertex returns them zeroed
+	//submeshStarts holds the first index of every submesh after the first one, which starts at 0
 	Mesh(const std::vector<Vertex_Input>& vertices, const std::vector<uint32_t>& indices, ID3D11Device* pDevice, bool canGoTransparant, bool canSwitchCullMode, const std::string& shaderPath,
-		const Elite::FMatrix4& worldMatrix = Elite::FMatrix4::Identity());
+		const Elite::FMatrix4& worldMatrix = Elite::FMatrix4::Identity(), const VertexFormat& vertexFormat = VertexFormat{}, const std::vector<uint32_t>& submeshStarts = {});
 	Mesh(const Mesh&) = delete;
 	Mesh& operator=(const Mesh&) = delete;
 	Mesh(Mesh&&) = delete;
 	Mesh& operator=(Mesh&&) = delete;
 	~Mesh();
 
+	//Also selects the LOD of every instance
 	void Update(const Camera* pCamera);
+	//Writes the instances to the GPU, grouped by LOD so every LOD is a single instanced draw
+	void UploadInstances(ID3D11DeviceContext* pDeviceContext);
+
+	//Returns the index of the new instance, the world matrix passed to the constructor is instance 0
+	uint32_t AddInstance(const Elite::FMatrix4& world, const Elite::RGBColor& tint = Elite::RGBColor{ 1.f, 1.f, 1.f });
+	void SetInstance(uint32_t index, const Elite::FMatrix4& world, const Elite::RGBColor& tint);
 
 
 	//Getters
+	//World matrix of instance 0
 	const Elite::FMatrix4& GetWorldMatrix() const;
-	const std::vector<Vertex_Input>& GetVertexBuffer() const;
-	const std::vector<uint32_t>& GetIndexBuffer() const;
+	const std::vector<Instance>& GetInstances() const;
+	//Unpacks a single vertex, in the rasterizer's space
+	Vertex_Input GetVertex(uint32_t index) const;
+	uint32_t GetAmountOfVertices() const;
+	const VertexFormat& GetVertexFormat() const;
+	const PositionStreams& GetPositionStreams() const;
+	const std::vector<Meshlet>& GetMeshlets() const;
+	const std::vector<uint32_t>& GetMeshletVertices() const;
+	const std::vector<Lod>& GetLods() const;
+	const std::vector<Submesh>& GetSubmeshes() const;
+	//Index and meshlet range of a submesh within a LOD, the submeshes of a LOD follow each other
+	const Lod& GetSubmeshLod(uint32_t lod, uint32_t submesh) const;
+	//Instances drawn with LOD i are [offsets[i], offsets[i + 1]) of the instance buffer
+	const std::vector<uint32_t>& GetLodInstanceOffsets() const;
+	//The instance of GetInstances() at an index of the instance buffer
+	const Instance& GetLodInstance(uint32_t index) const;
+	//Object space bounding box, in the rasterizer's space
+	const Elite::FPoint3& GetBoundsMin() const;
+	const Elite::FPoint3& GetBoundsMax() const;
+	//Only one of the index buffers is filled, depending on GetIndexFormat(), they hold the indices of every LOD
+	const std::vector<uint16_t>& GetIndexBuffer16() const;
+	const std::vector<uint32_t>& GetIndexBuffer32() const;
+	DXGI_FORMAT GetIndexFormat() const;
 	ID3D11Buffer* GetVertexBufferGPU() const;
 	ID3D11Buffer* GetIndexBufferGPU() const;
+	ID3D11Buffer* GetInstanceBufferGPU() const;
+	uint32_t GetInstanceStride() const;
 	int GetAmountOfIndices() const;
 
 	ID3D11InputLayout* GetInputLayout() const;
 	const BaseEffect* GetEffect() const;
+	const std::string& GetShaderPath() const;
+	//Same effect file, vertex format and textures, so the meshes can be merged into one StaticBatch
+	bool HasSameMaterial(const Mesh* pOther) const;
 
 	const Texture* GetDiffuse() const;
 	const Texture* GetNormal() const;
@@ -50,41 +147,119 @@ public:
 
 	const BaseEffect::EffectCullMode& GetCullMode() const;
 	bool CanGoTransparant() const;
+	//False for meshes that can go transparent, their meshlets follow the index order and they have no coarser LODs
+	bool CanReorderTriangles() const;
+	//Blending is on, a mesh that can go transparent never writes depth, even when blending is toggled off
+	bool IsTransparent() const;
 	bool CanSwitchCullMode() const;
 
 	//Setters
+	//Sets the world matrix of instance 0
 	void SetWorldMatrix(const Elite::FMatrix4& world);
 	void SetDiffuseMap(const std::string& path, ID3D11Device* pDevice);
 	void SetNormalMap(const std::string& path, ID3D11Device* pDevice);
 	void SetGlossinessMap(const std::string& path, ID3D11Device* pDevice);
 	void SetSpecularMap(const std::string& path, ID3D11Device* pDevice);
+	//Moves the textures of pSource to this mesh, pSource is left without textures
+	void TakeTextures(Mesh* pSource);
 	const BaseEffect::EffectSamplerState& ChangeSamplerState();
 	const BaseEffect::EffectCullMode& ChangeCullMode();
 	bool ToggleTransparancy();
+	//The software rasterizer blends the triangles of an order independent mesh with weighted blended OIT instead of sorting them
+	bool ToggleOrderIndependence();
+	bool IsOrderIndependent() const;
+	//The software rasterizer caches the color and depth of static opaque meshes while they and the camera don't change
+	void SetStatic(bool isStatic);
+	bool IsStatic() const;
+
+	//Set by every setter that changes how the mesh looks, so an idle renderer knows it has to draw again
+	bool IsDirty() const;
+	void ClearDirty();
 private:
 	//Shared
-	Elite::FMatrix4 m_World;
-	Elite::FMatrix4 m_WorldViewProj{};
+	std::vector<Instance> m_Instances;
 	uint32_t m_AmountIndices = 0;
 	Texture* m_pDiffuse = nullptr;
 	Texture* m_pNormal = nullptr;
 	Texture* m_pGlossiness = nullptr;
 	Texture* m_pSpecular = nullptr;
+	std::string m_ShaderPath;
 
 	//Rasterizer
-	std::vector<Vertex_Input> m_VertexBuffer;
-	std::vector<uint32_t> m_IndexBuffer;
+	VertexFormat m_VertexFormat;
+	std::vector<uint8_t> m_VertexBuffer;
+	uint32_t m_AmountVertices = 0;
+	PositionStreams m_PositionStreams;
+	Elite::FPoint3 m_BoundsMin{};
+	Elite::FPoint3 m_BoundsMax{};
+	std::vector<Meshlet> m_Meshlets;
+	std::vector<uint32_t> m_MeshletVertices;
+
+	//LODs
+	std::vector<Lod> m_Lods;
+	std::vector<Submesh> m_Submeshes;
+	//LOD lod of submesh s is at [lod * m_Submeshes.size() + s]
+	std::vector<Lod> m_SubmeshLods;
+	static const uint32_t m_MaxLods{ 5 };
+	static const uint32_t m_MinLodTriangles{ 64 };
+	//Every LOD keeps this fraction of the triangles of the previous one
+	static constexpr float m_LodReduction{ 0.4f };
+	//The coarsest LOD whose error stays below this many pixels on screen is used
+	static constexpr float m_LodPixelError{ 1.f };
+	//A coarser LOD is only picked once its error is this fraction below the limit, a finer one once the current error is this fraction above it, so the LOD doesn't flicker at the limit
+	static constexpr float m_LodHysteresis{ 0.25f };
+	//Meshes with at most 65536 vertices store 16-bit indices, halving the index memory and bandwidth
+	std::vector<uint16_t> m_IndexBuffer16;
+	std::vector<uint32_t> m_IndexBuffer32;
+	DXGI_FORMAT m_IndexFormat;
 
 	//DirectX
 	ID3D11InputLayout* m_pVertexLayout = nullptr;
 	ID3D11Buffer* m_pVertexBuffer = nullptr;
 	ID3D11Buffer* m_pIndexBuffer = nullptr;
+	ID3D11Buffer* m_pInstanceBuffer = nullptr;
+	uint32_t m_InstanceCapacity = 0;
+	//Layout of an instance in the instance buffer, matches the per instance input of the shaders
+	struct InstanceData
+	{
+		float World[16];
+		float Tint[4];
+	};
+	std::vector<InstanceData> m_InstanceData;
+	std::vector<uint32_t> m_LodInstanceOffsets;
+	//Index in m_Instances of every instance in the instance buffer
+	std::vector<uint32_t> m_LodInstanceIndices;
 	BaseEffect* m_pEffect = nullptr;
 
 	//Transparancy
 	bool m_CanGoTransparant;
+	//Blended meshes are drawn in index order, so their triangles keep the order they were passed in, in one LOD
+	bool m_CanReorderTriangles;
 
 	//Culling
 	bool m_CanSwitchCullMode;
+
+	bool m_IsStatic = false;
+	bool m_IsDirty = true;
+
+	//Compact vertices
+	Elite::FVector3 m_PositionScale{};
+	Elite::FPoint3 m_PositionOffset{};
+	Elite::FVector2 m_UVScale{};
+	Elite::FVector2 m_UVOffset{};
+
+	using PositionKey = FloatKey<3>;
+
+	void PackVertices(const std::vector<Vertex_Input>& vertices);
+	void FillPositionStreams();
+	void CalculateSubmeshBounds(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& submeshStarts);
+	//Simplifies indices into the LOD chain and builds the meshlets of every LOD, returns the indices of all LODs after each other
+	//Every submesh is simplified and split into meshlets on its own, so it keeps a consecutive range in every LOD
+	std::vector<uint32_t> BuildLods(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& submeshStarts);
+	//Picks the LOD for an instance, starting from the one it used last frame
+	uint32_t SelectLod(const Instance& instance, const Elite::FMatrix4& viewProj, const Camera* pCamera) const;
+	void CalculateCompactBounds(const std::vector<Vertex_Input>& vertices);
+	static void EncodeOctahedral(const Elite::FVector3& direction, int16_t encoded[2]);
+	static Elite::FVector3 DecodeOctahedral(const int16_t encoded[2]);
 };
 
@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+bool MeshCache::Read(const std::string& sourceFileName, uint32_t attributes, bool canReorderTriangles, std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer)
+{
+	uint64_t sourceSize{};
+	int64_t sourceWriteTime{};
+	if (!GetSourceInfo(sourceFileName, sourceSize, sourceWriteTime))
+		return false;
+
+	MappedFile input{ GetCacheFileName(sourceFileName) };
+	if (!input.IsOpen() || input.GetSize() < sizeof(Header))
+		return false;
+
+	Header header{};
+	std::memcpy(&header, input.GetData(), sizeof(Header));
+	if (std::memcmp(header.magic, "MSHC", sizeof(header.magic)) != 0
+		|| header.version != m_Version
+		|| header.vertexStride != sizeof(Mesh::Vertex_Input)
+		|| header.attributes != attributes
+		|| header.canReorderTriangles != uint32_t(canReorderTriangles)
+		|| header.sourceSize != sourceSize
+		|| header.sourceWriteTime != sourceWriteTime
+		|| header.pathLength != sourceFileName.size())
+		return false;
+
+	const size_t pathOffset{ sizeof(Header) };
+	const size_t vertexOffset{ Align(pathOffset + header.pathLength) };
+	const size_t indexOffset{ Align(vertexOffset + header.vertexCount * sizeof(Mesh::Vertex_Input)) };
+	const size_t fileSize{ indexOffset + header.indexCount * sizeof(uint32_t) };
+	if (input.GetSize() != fileSize || sourceFileName.compare(0, std::string::npos, input.GetData() + pathOffset, header.pathLength) != 0)
+		return false;
+
+	//The streams are stored exactly as they are used, loading is just a copy out of the mapped pages
+	const Mesh::Vertex_Input* pVertices{ reinterpret_cast<const Mesh::Vertex_Input*>(input.GetData() + vertexOffset) };
+	vertexBuffer.assign(pVertices, pVertices + header.vertexCount);
+
+	const uint32_t* pIndices{ reinterpret_cast<const uint32_t*>(input.GetData() + indexOffset) };
+	indexBuffer.assign(pIndices, pIndices + header.indexCount);
+
+	return true;
+}
+
+void MeshCache::Write(const std::string& sourceFileName, uint32_t attributes, bool canReorderTriangles, const std::vector<Mesh::Vertex_Input>& vertexBuffer, const std::vector<uint32_t>& indexBuffer)
+{
+	Header header{};
+	std::memcpy(header.magic, "MSHC", sizeof(header.magic));
+	header.version = m_Version;
+	header.vertexStride = sizeof(Mesh::Vertex_Input);
+	header.attributes = attributes;
+	header.canReorderTriangles = uint32_t(canReorderTriangles);
+	header.pathLength = uint32_t(sourceFileName.size());
+	header.vertexCount = vertexBuffer.size();
+	header.indexCount = indexBuffer.size();
+	if (!GetSourceInfo(sourceFileName, header.sourceSize, header.sourceWriteTime))
+		return;
+
+	const std::string cacheFileName{ GetCacheFileName(sourceFileName) };
+	std::ofstream output{ cacheFileName, std::ios::binary | std::ios::trunc };
+	if (!output.is_open())
+	{
+		std::cout << "Could not write mesh cache: " << cacheFileName << '\n';
+		return;
+	}
+
+	const char padding[m_Alignment]{};
+	const size_t vertexOffset{ Align(sizeof(Header) + sourceFileName.size()) };
+	const size_t vertexBytes{ vertexBuffer.size() * sizeof(Mesh::Vertex_Input) };
+	const size_t indexOffset{ Align(vertexOffset + vertexBytes) };
+
+	output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	output.write(sourceFileName.data(), sourceFileName.size());
+	output.write(padding, vertexOffset - sizeof(Header) - sourceFileName.size());
+	output.write(reinterpret_cast<const char*>(vertexBuffer.data()), vertexBytes);
+	output.write(padding, indexOffset - vertexOffset - vertexBytes);
+	output.write(reinterpret_cast<const char*>(indexBuffer.data()), indexBuffer.size() * sizeof(uint32_t));
+
+	if (!output.good())
+	{
+		//Never leave a half written cache behind
+		output.close();
+		std::error_code error{};
+		std::filesystem::remove(cacheFileName, error);
+		std::cout << "Could not write mesh cache: " << cacheFileName << '\n';
+	}
+}
+
+std::string MeshCache::GetCacheFileName(const std::string& sourceFileName)
+{
+	return sourceFileName + ".meshcache";
+}
+
+bool MeshCache::GetSourceInfo(const std::string& sourceFileName, uint64_t& size, int64_t& writeTime)
+{
+	std::error_code error{};
+	size = std::filesystem::file_size(sourceFileName, error);
+	if (error)
+		return false;
+
+	const std::filesystem::file_time_type lastWriteTime{ std::filesystem::last_write_time(sourceFileName, error) };
+	if (error)
+		return false;
+
+	writeTime = int64_t(lastWriteTime.time_since_epoch().count());
+	return true;
+}
+
+size_t MeshCache::Align(size_t offset)
+{
+	return (offset + m_Alignment - 1) / m_Alignment * m_Alignment;
+}
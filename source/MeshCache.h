@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+//Binary copy of a parsed mesh, stored next to its source file as "<source>.meshcache"
+//The cache is only used while the source path, size, last write time, vertex attributes and triangle reordering match the ones it was written for
+class MeshCache final
+{
+public:
+	//Replaces the contents of vertexBuffer and indexBuffer, returns false if there is no valid cache for the source file
+	//attributes are the VertexFormat attributes the mesh was read with, canReorderTriangles whether MeshOptimizer could reorder its triangles
+	static bool Read(const std::string& sourceFileName, uint32_t attributes, bool canReorderTriangles, std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer);
+	static void Write(const std::string& sourceFileName, uint32_t attributes, bool canReorderTriangles, const std::vector<Mesh::Vertex_Input>& vertexBuffer, const std::vector<uint32_t>& indexBuffer);
+private:
+	MeshCache() = default;
+
+	//File layout: Header, source path (padded to m_Alignment), vertex stream, index stream
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t vertexStride;
+		uint32_t attributes;
+		uint32_t canReorderTriangles;
+		uint32_t pathLength;
+		uint64_t sourceSize;
+		int64_t sourceWriteTime;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+	};
+	static const uint32_t m_Version{ 5 };
+	static const size_t m_Alignment{ 16 };
+
+	static std::string GetCacheFileName(const std::string& sourceFileName);
+	static bool GetSourceInfo(const std::string& sourceFileName, uint64_t& size, int64_t& writeTime);
+	static size_t Align(size_t offset);
+};
+
@@ -0,0 +1,212 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include <numeric>
+
+void MeshOptimizer::Optimize(std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer, bool canReorderTriangles)
+{
+	if (canReorderTriangles)
+	{
+		std::vector<size_t> clusterStarts{};
+		OptimizeVertexCache(indexBuffer, vertexBuffer.size(), clusterStarts);
+		OptimizeOverdraw(vertexBuffer, indexBuffer, clusterStarts);
+	}
+	OptimizeVertexFetch(vertexBuffer, indexBuffer);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indexBuffer, size_t vertexCount, std::vector<size_t>& clusterStarts)
+{
+	clusterStarts.clear();
+	const size_t triangleCount{ indexBuffer.size() / 3 };
+	if (triangleCount == 0)
+		return;
+
+	//Triangles adjacent to every vertex, adjacentTriangles[triangleOffsets[v] .. triangleOffsets[v + 1]]
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+	for (uint32_t index : indexBuffer) triangleOffsets[index + 1]++;
+	std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+
+	std::vector<uint32_t> adjacentTriangles(indexBuffer.size());
+	std::vector<uint32_t> fillOffsets(triangleOffsets.begin(), triangleOffsets.end() - 1);
+	for (size_t i = 0; i < indexBuffer.size(); i++)
+	{
+		adjacentTriangles[fillOffsets[indexBuffer[i]]++] = uint32_t(i / 3);
+	}
+
+	//Amount of not yet emitted triangles per vertex
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) liveTriangles[v] = triangleOffsets[v + 1] - triangleOffsets[v];
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd{};
+	std::vector<uint32_t> candidates{};
+	std::vector<uint32_t> output{};
+	output.reserve(indexBuffer.size());
+
+	uint32_t time{ m_CacheSize + 1 };
+	uint32_t cursor{ 0 };
+	int64_t fanningVertex{ SkipDeadEnd(deadEnd, liveTriangles, cursor) };
+	size_t clusterStart{ 0 };
+	clusterStarts.push_back(0);
+
+	while (fanningVertex >= 0)
+	{
+		//Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t i = triangleOffsets[fanningVertex]; i < triangleOffsets[fanningVertex + 1]; i++)
+		{
+			const uint32_t triangle{ adjacentTriangles[i] };
+			if (isEmitted[triangle]) continue;
+
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t v{ indexBuffer[triangle * 3 + corner] };
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				//Not in the cache anymore, so this counts as a cache miss
+				if (time - cacheTime[v] > m_CacheSize)
+				{
+					cacheTime[v] = time;
+					time++;
+				}
+			}
+			isEmitted[triangle] = true;
+		}
+
+		fanningVertex = GetNextVertex(candidates, liveTriangles, cacheTime, time);
+		if (fanningVertex < 0)
+		{
+			//Jumping away from the current neighbourhood, so the next cluster can start here
+			fanningVertex = SkipDeadEnd(deadEnd, liveTriangles, cursor);
+			const size_t emittedTriangles{ output.size() / 3 };
+			if (fanningVertex >= 0 && emittedTriangles - clusterStart >= m_MinClusterSize)
+			{
+				clusterStart = emittedTriangles;
+				clusterStarts.push_back(clusterStart);
+			}
+		}
+	}
+
+	indexBuffer.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer, const std::vector<size_t>& clusterStarts)
+{
+	const size_t triangleCount{ indexBuffer.size() / 3 };
+	const size_t clusterCount{ clusterStarts.size() };
+	if (clusterCount < 2)
+		return;
+
+	//Area weighted centroid of the whole mesh and of every cluster
+	//The cluster normal is the sum of the vertex normals, which does not depend on the winding order
+	std::vector<Elite::FVector3> clusterCentroids(clusterCount);
+	std::vector<Elite::FVector3> clusterNormals(clusterCount);
+	std::vector<float> clusterAreas(clusterCount, 0.f);
+	Elite::FVector3 meshCentroid{};
+	float meshArea{};
+
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		const size_t end{ cluster + 1 < clusterCount ? clusterStarts[cluster + 1] : triangleCount };
+		for (size_t triangle = clusterStarts[cluster]; triangle < end; triangle++)
+		{
+			const Mesh::Vertex_Input& v0{ vertexBuffer[indexBuffer[triangle * 3]] };
+			const Mesh::Vertex_Input& v1{ vertexBuffer[indexBuffer[triangle * 3 + 1]] };
+			const Mesh::Vertex_Input& v2{ vertexBuffer[indexBuffer[triangle * 3 + 2]] };
+
+			const float area{ Elite::Magnitude(Elite::Cross(v1.Position - v0.Position, v2.Position - v0.Position)) * 0.5f };
+			const Elite::FVector3 centroid{ (Elite::FVector3{ v0.Position } + Elite::FVector3{ v1.Position } + Elite::FVector3{ v2.Position }) / 3.f };
+
+			clusterCentroids[cluster] += centroid * area;
+			clusterAreas[cluster] += area;
+			clusterNormals[cluster] += v0.Normal + v1.Normal + v2.Normal;
+		}
+		meshCentroid += clusterCentroids[cluster];
+		meshArea += clusterAreas[cluster];
+		if (clusterAreas[cluster] > 0.f) clusterCentroids[cluster] /= clusterAreas[cluster];
+	}
+	if (meshArea > 0.f) meshCentroid /= meshArea;
+
+	std::vector<float> occlusion(clusterCount, 0.f);
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		if (Elite::SqrMagnitude(clusterNormals[cluster]) > 0.f)
+			occlusion[cluster] = Elite::Dot(clusterCentroids[cluster] - meshCentroid, Elite::GetNormalized(clusterNormals[cluster]));
+	}
+
+	std::vector<size_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&occlusion](size_t a, size_t b) { return occlusion[a] > occlusion[b]; });
+
+	std::vector<uint32_t> output{};
+	output.reserve(indexBuffer.size());
+	for (size_t cluster : order)
+	{
+		const size_t end{ cluster + 1 < clusterCount ? clusterStarts[cluster + 1] : triangleCount };
+		output.insert(output.end(), indexBuffer.begin() + clusterStarts[cluster] * 3, indexBuffer.begin() + end * 3);
+	}
+
+	indexBuffer.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer)
+{
+	const uint32_t unused{ UINT32_MAX };
+	std::vector<uint32_t> remap(vertexBuffer.size(), unused);
+	std::vector<Mesh::Vertex_Input> output{};
+	output.reserve(vertexBuffer.size());
+
+	for (uint32_t& index : indexBuffer)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = uint32_t(output.size());
+			output.push_back(vertexBuffer[index]);
+		}
+		index = remap[index];
+	}
+
+	vertexBuffer.swap(output);
+}
+
+int64_t MeshOptimizer::GetNextVertex(const std::vector<uint32_t>& candidates, const std::vector<uint32_t>& liveTriangles, const std::vector<uint32_t>& cacheTime, uint32_t time)
+{
+	//Prefer the candidate that has been in the cache the longest, as long as all of its triangles still fit before it gets evicted
+	int64_t bestVertex{ -1 };
+	int64_t bestPriority{ -1 };
+	for (uint32_t candidate : candidates)
+	{
+		if (liveTriangles[candidate] == 0) continue;
+
+		int64_t priority{ 0 };
+		if (time - cacheTime[candidate] + 2 * liveTriangles[candidate] <= m_CacheSize) priority = time - cacheTime[candidate];
+
+		if (priority > bestPriority)
+		{
+			bestPriority = priority;
+			bestVertex = candidate;
+		}
+	}
+	return bestVertex;
+}
+
+int64_t MeshOptimizer::SkipDeadEnd(std::vector<uint32_t>& deadEnd, const std::vector<uint32_t>& liveTriangles, uint32_t& cursor)
+{
+	//Recently used vertices first, they might still be in the cache
+	while (!deadEnd.empty())
+	{
+		const uint32_t vertex{ deadEnd.back() };
+		deadEnd.pop_back();
+		if (liveTriangles[vertex] > 0) return vertex;
+	}
+
+	//Otherwise continue with the next vertex in input order
+	while (cursor < liveTriangles.size())
+	{
+		if (liveTriangles[cursor] > 0) return cursor;
+		cursor++;
+	}
+	return -1;
+}
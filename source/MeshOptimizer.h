@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "Mesh.h"
+
+//Reorders the vertex and index buffer of a mesh for the GPU and the software rasterizer
+//Renumbering the vertices never changes the rendered result, reordering the triangles only keeps it for meshes drawn with depth writes and without blending
+//Based on "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007)
+class MeshOptimizer final
+{
+public:
+	//Runs all passes below, in order, without canReorderTriangles only OptimizeVertexFetch runs and the triangles keep their order
+	static void Optimize(std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer, bool canReorderTriangles);
+
+	//Tipsify: orders triangles so vertices are reused while they're still in the post-transform cache
+	//clusterStarts receives the first triangle of every cluster, clusters can be reordered without hurting the cache much
+	static void OptimizeVertexCache(std::vector<uint32_t>& indexBuffer, size_t vertexCount, std::vector<size_t>& clusterStarts);
+	//Sorts the clusters so the ones facing away from the mesh center are drawn first, which lets early depth rejection discard more of the rest
+	static void OptimizeOverdraw(const std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer, const std::vector<size_t>& clusterStarts);
+	//Renumbers the vertices in the order the index buffer first uses them, unused vertices are dropped
+	static void OptimizeVertexFetch(std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer);
+private:
+	MeshOptimizer() = default;
+
+	static const uint32_t m_CacheSize{ 16 };
+	//Clusters smaller than this are merged with the next one, tiny clusters would throw away too much cache reuse when sorted
+	static const size_t m_MinClusterSize{ 64 };
+
+	static int64_t GetNextVertex(const std::vector<uint32_t>& candidates, const std::vector<uint32_t>& liveTriangles, const std::vector<uint32_t>& cacheTime, uint32_t time);
+	static int64_t SkipDeadEnd(std::vector<uint32_t>& deadEnd, const std::vector<uint32_t>& liveTriangles, uint32_t& cursor);
+};
+
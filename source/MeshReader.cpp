@@ -1,188 +1,266 @@
 #include "pch.h"
 #include "MeshReader.h"
-#include <fstream>
-#include <sstream>
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include <charconv>
+#include <cstring>
 #include <iostream>
-#include <regex>
+#include <thread>
+#include <unordered_map>
 
-void MeshReader::ReadObjFile(const std::string& fileName, std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer)
+void MeshReader::ReadObjFile(const std::string& fileName, std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer,
+    const VertexFormat& vertexFormat, bool canReorderTriangles, uint32_t threadCount)
 {
-    std::ifstream input{ fileName };
-    std::string line{};
+    vertexBuffer.clear();
+    indexBuffer.clear();
 
-    Elite::FPoint3 fpoint3{};
-    Face face{};
+    //A previous run already parsed this exact file
+    if (MeshCache::Read(fileName, vertexFormat.GetAttributes(), canReorderTriangles, vertexBuffer, indexBuffer))
+        return;
+
+    MappedFile input{ fileName };
+    if (!input.IsOpen())
+    {
+        std::cout << "Could not open obj file: " << fileName << '\n';
+        return;
+    }
 
-    std::vector<Elite::FPoint3> posBuffer{};
-    std::vector<Elite::FPoint3> uvBuffer{};
-    std::vector<Elite::FPoint3> normalBuffer{};
+    //Split the file into one chunk per thread, every chunk starts at the beginning of a line
+    if (threadCount == 0) threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    const size_t chunkCount{ std::clamp(input.GetSize() / m_MinChunkSize, size_t(1), size_t(threadCount)) };
 
-    if (input.is_open())
+    std::vector<Chunk> chunks(chunkCount);
+    const char* pChunkStart{ input.GetData() };
+    const char* pEnd{ pChunkStart + input.GetSize() };
+    for (size_t i = 0; i < chunkCount; i++)
     {
-        while (std::getline(input, line))
+        const char* pChunkEnd{ pEnd };
+        if (i + 1 < chunkCount)
         {
-            if (IsVertex(line, fpoint3))
-            {
-                posBuffer.push_back(fpoint3);
-            }
+            pChunkEnd = std::max(pChunkStart, input.GetData() + input.GetSize() / chunkCount * (i + 1));
+            pChunkEnd = static_cast<const char*>(std::memchr(pChunkEnd, '\n', size_t(pEnd - pChunkEnd)));
+            pChunkEnd = (pChunkEnd == nullptr) ? pEnd : pChunkEnd + 1;
+        }
+        chunks[i].text = std::string_view{ pChunkStart, size_t(pChunkEnd - pChunkStart) };
+        pChunkStart = pChunkEnd;
+    }
 
-            if (IsUV(line, fpoint3))
-            {
-                uvBuffer.push_back(fpoint3);
-            }
+    //Parse all records, faces can reference attributes from other chunks so they are only resolved afterwards
+    RunParallel(chunkCount, [&chunks](size_t i) { ParseChunk(chunks[i]); });
 
-            if (IsNormal(line, fpoint3))
-            {
-                normalBuffer.push_back(fpoint3);
-            }
+    //Prefix sum over the chunk sizes gives every chunk its place in the global attribute buffers
+    std::vector<size_t> posOffsets(chunkCount), uvOffsets(chunkCount), normalOffsets(chunkCount);
+    size_t posCount{}, uvCount{}, normalCount{};
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        posOffsets[i] = posCount;
+        uvOffsets[i] = uvCount;
+        normalOffsets[i] = normalCount;
+        posCount += chunks[i].positions.size();
+        uvCount += chunks[i].uvs.size();
+        normalCount += chunks[i].normals.size();
+    }
+
+    std::vector<Elite::FPoint3> posBuffer(posCount);
+    std::vector<Elite::FPoint3> uvBuffer(uvCount);
+    std::vector<Elite::FPoint3> normalBuffer(normalCount);
+    RunParallel(chunkCount, [&](size_t i)
+        {
+            std::copy(chunks[i].positions.begin(), chunks[i].positions.end(), posBuffer.begin() + posOffsets[i]);
+            std::copy(chunks[i].uvs.begin(), chunks[i].uvs.end(), uvBuffer.begin() + uvOffsets[i]);
+            std::copy(chunks[i].normals.begin(), chunks[i].normals.end(), normalBuffer.begin() + normalOffsets[i]);
+        });
+
+    //Build the vertices of every face and deduplicate them within their chunk
+    RunParallel(chunkCount, [&](size_t i) { ResolveChunkFaces(chunks[i], posBuffer, uvBuffer, normalBuffer, vertexFormat); });
+
+    //Merge the chunk-local vertices in file order, so the result does not depend on the amount of chunks
+    //Maps every vertex that was already emitted to its index in vertexBuffer
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexLookup{};
+    std::vector<size_t> indexOffsets(chunkCount);
+    size_t indexCount{};
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        Chunk& chunk{ chunks[i] };
+        chunk.remap.resize(chunk.vertices.size());
+        for (size_t vertex = 0; vertex < chunk.vertices.size(); vertex++)
+        {
+            chunk.remap[vertex] = AddVertex(chunk.vertices[vertex], vertexBuffer, vertexLookup);
+        }
+        indexOffsets[i] = indexCount;
+        indexCount += chunk.indices.size();
+    }
 
-            if (IsFace(line, face))
+    indexBuffer.resize(indexCount);
+    RunParallel(chunkCount, [&](size_t i)
+        {
+            const Chunk& chunk{ chunks[i] };
+            for (size_t index = 0; index < chunk.indices.size(); index++)
             {
-                Mesh::Vertex_Input v0{ posBuffer[face.v0], Elite::FVector2{Elite::FPoint2{uvBuffer[face.vt0]}}, Elite::FVector3{normalBuffer[face.vn0]} };
-                Mesh::Vertex_Input v1{ posBuffer[face.v1], Elite::FVector2{Elite::FPoint2{uvBuffer[face.vt1]}}, Elite::FVector3{normalBuffer[face.vn1]} };
-                Mesh::Vertex_Input v2{ posBuffer[face.v2], Elite::FVector2{Elite::FPoint2{uvBuffer[face.vt2]}}, Elite::FVector3{normalBuffer[face.vn2]} };
-
-                //https://stackoverflow.com/questions/5255806/how-to-calculate-tangent-and-binormal
-                const Elite::FVector3 edge0 = Elite::FPoint3{ v1.Position } - Elite::FPoint3{ v0.Position};
-                const Elite::FVector3 edge1 = Elite::FPoint3{ v2.Position } - Elite::FPoint3{ v0.Position };
-                const Elite::FVector2 diffX{ v1.UV.x - v0.UV.x, v2.UV.x - v0.UV.x };
-                const Elite::FVector2 diffY{ v1.UV.y - v0.UV.y, v2.UV.y - v0.UV.y };
-                float r = 1.f / Elite::Cross(diffX, diffY);
-
-                Elite::FVector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
-                v0.Tangent = -Elite::GetNormalized(Elite::Reject(tangent, v0.Normal));
-                v1.Tangent = -Elite::GetNormalized(Elite::Reject(tangent, v1.Normal));
-                v2.Tangent = -Elite::GetNormalized(Elite::Reject(tangent, v2.Normal));
-
-                //Check if duplicate vertex already exist
-                //If not, add it to vertexBuffer
-                const int invalid_index{ -1 };
-                int i0{ invalid_index }, i1{ invalid_index }, i2{ invalid_index };
-                int i{0};
-                for (const Mesh::Vertex_Input& v : vertexBuffer)
-                {
-                    if (v == v0) i0 = i;
-                    if (v == v1) i1 = i;
-                    if (v == v2) i2 = i;
-                    i++;
-                }
-
-                if (i0 == invalid_index)
-                {
-                    vertexBuffer.push_back(v0);
-                    i0 = int(vertexBuffer.size()) - 1;
-                }
-
-                if (i1 == invalid_index)
-                {
-                    vertexBuffer.push_back(v1);
-                    i1 = int(vertexBuffer.size()) - 1;
-                }
-
-                if (i2 == invalid_index)
-                {
-                    vertexBuffer.push_back(v2);
-                    i2 = int(vertexBuffer.size()) - 1;
-                }
-
-                indexBuffer.push_back(i0);
-                indexBuffer.push_back(i1);
-                indexBuffer.push_back(i2);
+                indexBuffer[indexOffsets[i] + index] = chunk.remap[chunk.indices[index]];
             }
+        });
+
+    //Reordering is done once here, so the cache stores the optimized buffers
+    MeshOptimizer::Optimize(vertexBuffer, indexBuffer, canReorderTriangles);
+    MeshCache::Write(fileName, vertexFormat.GetAttributes(), canReorderTriangles, vertexBuffer, indexBuffer);
+}
+
+void MeshReader::ParseChunk(Chunk& chunk)
+{
+    Elite::FPoint3 fpoint3{};
+    Face face{};
+
+    const char* pCurrent{ chunk.text.data() };
+    const char* pEnd{ pCurrent + chunk.text.size() };
+    while (pCurrent < pEnd)
+    {
+        //Split off the next line without copying it
+        const char* pLineEnd{ static_cast<const char*>(std::memchr(pCurrent, '\n', size_t(pEnd - pCurrent))) };
+        if (pLineEnd == nullptr) pLineEnd = pEnd;
+        std::string_view line{ pCurrent, size_t(pLineEnd - pCurrent) };
+        pCurrent = pLineEnd + 1;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        if (IsVertex(line, fpoint3))
+        {
+            chunk.positions.push_back(fpoint3);
+        }
+        else if (IsUV(line, fpoint3))
+        {
+            chunk.uvs.push_back(fpoint3);
+        }
+        else if (IsNormal(line, fpoint3))
+        {
+            chunk.normals.push_back(fpoint3);
+        }
+        else if (IsFace(line, face))
+        {
+            chunk.faces.push_back(face);
         }
     }
 }
 
-bool MeshReader::IsVertex(const std::string& line, Elite::FPoint3& vertex)
+void MeshReader::ResolveChunkFaces(Chunk& chunk, const std::vector<Elite::FPoint3>& posBuffer, const std::vector<Elite::FPoint3>& uvBuffer, const std::vector<Elite::FPoint3>& normalBuffer,
+    const VertexFormat& vertexFormat)
 {
-    std::stringstream ss{ line };
-    std::string string;
-    std::getline(ss, string, ' ');
-    if (string != "v") return false;
+    //Maps every vertex that was already emitted to its index in chunk.vertices
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexLookup{};
+    chunk.indices.reserve(chunk.faces.size() * 3);
 
-    ss >> vertex.x;
-    ss >> vertex.y;
-    ss >> vertex.z;
+    for (const Face& face : chunk.faces)
+    {
+        Mesh::Vertex_Input v0{ posBuffer[face.v0], Elite::FVector2{Elite::FPoint2{uvBuffer[face.vt0]}}, Elite::FVector3{normalBuffer[face.vn0]} };
+        Mesh::Vertex_Input v1{ posBuffer[face.v1], Elite::FVector2{Elite::FPoint2{uvBuffer[face.vt1]}}, Elite::FVector3{normalBuffer[face.vn1]} };
+        Mesh::Vertex_Input v2{ posBuffer[face.v2], Elite::FVector2{Elite::FPoint2{uvBuffer[face.vt2]}}, Elite::FVector3{normalBuffer[face.vn2]} };
 
-    vertex.z = -vertex.z;
+        //https://stackoverflow.com/questions/5255806/how-to-calculate-tangent-and-binormal
+        if (vertexFormat.Has(VertexFormat::Tangent))
+        {
+            const Elite::FVector3 edge0 = Elite::FPoint3{ v1.Position } - Elite::FPoint3{ v0.Position};
+            const Elite::FVector3 edge1 = Elite::FPoint3{ v2.Position } - Elite::FPoint3{ v0.Position };
+            const Elite::FVector2 diffX{ v1.UV.x - v0.UV.x, v2.UV.x - v0.UV.x };
+            const Elite::FVector2 diffY{ v1.UV.y - v0.UV.y, v2.UV.y - v0.UV.y };
+            float r = 1.f / Elite::Cross(diffX, diffY);
+
+            Elite::FVector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
+            v0.Tangent = -Elite::GetNormalized(Elite::Reject(tangent, v0.Normal));
+            v1.Tangent = -Elite::GetNormalized(Elite::Reject(tangent, v1.Normal));
+            v2.Tangent = -Elite::GetNormalized(Elite::Reject(tangent, v2.Normal));
+        }
 
-    if (ss.fail()) return false;
+        //The tangent needs the uvs and normals, only drop them afterwards
+        for (Mesh::Vertex_Input* pVertex : { &v0, &v1, &v2 })
+        {
+            if (!vertexFormat.Has(VertexFormat::UV)) pVertex->UV = {};
+            if (!vertexFormat.Has(VertexFormat::Normal)) pVertex->Normal = {};
+        }
+
+        //Check if duplicate vertex already exist
+        //If not, add it to the chunk's vertices
+        chunk.indices.push_back(AddVertex(v0, chunk.vertices, vertexLookup));
+        chunk.indices.push_back(AddVertex(v1, chunk.vertices, vertexLookup));
+        chunk.indices.push_back(AddVertex(v2, chunk.vertices, vertexLookup));
+    }
+}
+
+void MeshReader::RunParallel(size_t count, const std::function<void(size_t)>& task)
+{
+    //The calling thread takes the first task itself
+    std::vector<std::thread> threads{};
+    threads.reserve(count);
+    for (size_t i = 1; i < count; i++)
+    {
+        threads.emplace_back(task, i);
+    }
+    if (count > 0) task(0);
+
+    for (std::thread& thread : threads) thread.join();
+}
+
+MeshReader::VertexKey MeshReader::GetVertexKey(const Mesh::Vertex_Input& vertex)
+{
+    return VertexKey{ { vertex.Position.x, vertex.Position.y, vertex.Position.z, vertex.UV.x, vertex.UV.y, vertex.Normal.x, vertex.Normal.y, vertex.Normal.z } };
+}
+
+uint32_t MeshReader::AddVertex(const Mesh::Vertex_Input& vertex, std::vector<Mesh::Vertex_Input>& vertexBuffer, std::unordered_map<VertexKey, uint32_t, VertexKeyHash>& vertexLookup)
+{
+    const auto result{ vertexLookup.try_emplace(GetVertexKey(vertex), uint32_t(vertexBuffer.size())) };
+    if (result.second) vertexBuffer.push_back(vertex);
+
+    return result.first->second;
+}
+
+bool MeshReader::IsVertex(std::string_view line, Elite::FPoint3& vertex)
+{
+    if (!ReadKeyword(line, "v")) return false;
+
+    if (!ReadNumber(line, vertex.x)) return false;
+    if (!ReadNumber(line, vertex.y)) return false;
+    if (!ReadNumber(line, vertex.z)) return false;
+
+    vertex.z = -vertex.z;
 
     return true;
 }
 
-bool MeshReader::IsUV(const std::string& line, Elite::FPoint3& uv)
+bool MeshReader::IsUV(std::string_view line, Elite::FPoint3& uv)
 {
-    std::stringstream ss{ line };
-    std::string string;
-    std::getline(ss, string, ' ');
-    if (string != "vt") return false;
+    if (!ReadKeyword(line, "vt")) return false;
 
-    ss >> uv.x;
-    ss >> uv.y;
-    ss >> uv.z;
+    if (!ReadNumber(line, uv.x)) return false;
+    if (!ReadNumber(line, uv.y)) return false;
+    //w is optional
+    if (!ReadNumber(line, uv.z)) uv.z = 0.f;
 
     uv.y = 1 - uv.y;
 
-    if (ss.fail()) return false;
-
     return true;
 }
 
-bool MeshReader::IsNormal(const std::string& line, Elite::FPoint3& normal)
+bool MeshReader::IsNormal(std::string_view line, Elite::FPoint3& normal)
 {
-    std::stringstream ss{ line };
-    std::string string;
-    std::getline(ss, string, ' ');
-    if (string != "vn") return false;
+    if (!ReadKeyword(line, "vn")) return false;
 
-    ss >> normal.x;
-    ss >> normal.y;
-    ss >> normal.z;
+    if (!ReadNumber(line, normal.x)) return false;
+    if (!ReadNumber(line, normal.y)) return false;
+    if (!ReadNumber(line, normal.z)) return false;
 
     normal.z = -normal.z;
 
-    if (ss.fail()) return false;
-
     return true;
 }
 
-bool MeshReader::IsFace(const std::string& line, Face& face)
+bool MeshReader::IsFace(std::string_view line, Face& face)
 {
-    std::stringstream ss{ line };
-    std::string string;
-    std::getline(ss, string, ' ');
-    if (string != "f") return false;
+    if (!ReadKeyword(line, "f")) return false;
 
-    try
+    if (!ReadFaceVertex(line, face.v0, face.vt0, face.vn0)
+        || !ReadFaceVertex(line, face.v1, face.vt1, face.vn1)
+        || !ReadFaceVertex(line, face.v2, face.vt2, face.vn2))
     {
-        //Vertex 0
-        std::getline(ss, string, '/');
-        face.v0 = std::stoi(string);
-        std::getline(ss, string, '/');
-        face.vt0 = std::stoi(string);
-        std::getline(ss, string, ' ');
-        face.vn0 = std::stoi(string);
-
-        //Vertex 1
-        std::getline(ss, string, '/');
-        face.v1 = std::stoi(string);
-        std::getline(ss, string, '/');
-        face.vt1 = std::stoi(string);
-        std::getline(ss, string, ' ');
-        face.vn1 = std::stoi(string);
-
-        //Vertex 2
-        std::getline(ss, string, '/');
-        face.v2 = std::stoi(string);
-        std::getline(ss, string, '/');
-        face.vt2 = std::stoi(string);
-        std::getline(ss, string, ' ');
-        face.vn2 = std::stoi(string);
-    }
-    catch (const std::exception& e)
-    {
-        std::cout << "Something went wrong when parsing obj face: " << e.what() << '\n';
+        std::cout << "Something went wrong when parsing obj face: " << line << '\n';
         return false;
     }
 
@@ -199,7 +277,37 @@ bool MeshReader::IsFace(const std::string& line, Face& face)
     --face.vt1;
     --face.vt2;
 
-    if (ss.fail()) return false;
+    return true;
+}
+
+bool MeshReader::ReadKeyword(std::string_view& line, std::string_view keyword)
+{
+    //The keyword has to be followed by whitespace, otherwise "v" would also match "vt" and "vn"
+    if (line.size() <= keyword.size() || line.compare(0, keyword.size(), keyword) != 0) return false;
+    if (line[keyword.size()] != ' ' && line[keyword.size()] != '\t') return false;
+
+    line.remove_prefix(keyword.size());
+    return true;
+}
+
+template<typename NumberType>
+bool MeshReader::ReadNumber(std::string_view& line, NumberType& value)
+{
+    while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) line.remove_prefix(1);
+
+    const std::from_chars_result result{ std::from_chars(line.data(), line.data() + line.size(), value) };
+    if (result.ec != std::errc{}) return false;
 
+    line.remove_prefix(size_t(result.ptr - line.data()));
     return true;
 }
+
+bool MeshReader::ReadFaceVertex(std::string_view& line, int& v, int& vt, int& vn)
+{
+    //v/vt/vn
+    if (!ReadNumber(line, v) || line.empty() || line.front() != '/') return false;
+    line.remove_prefix(1);
+    if (!ReadNumber(line, vt) || line.empty() || line.front() != '/') return false;
+    line.remove_prefix(1);
+    return ReadNumber(line, vn);
+}
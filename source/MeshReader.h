@@ -1,13 +1,23 @@
 #pragma once
+#include <functional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include "EMath.h"
+#include "FloatKey.h"
 #include "Mesh.h"
 
 class MeshReader final
 {
 public:
-	static void ReadObjFile(const std::string& fileName, std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer);
+	//Replaces the contents of vertexBuffer and indexBuffer, the result is written to a MeshCache and read from there on later loads
+	//Attributes that are not in vertexFormat are left zeroed, so vertices that only differ in those are welded and tangents are only calculated when needed
+	//canReorderTriangles lets MeshOptimizer reorder the triangles for the vertex cache and overdraw, only for meshes that write depth and don't blend
+	//Blended meshes are drawn in index order, so they have to keep the triangle order of the file
+	//threadCount 0 uses every hardware thread, the result is the same for any amount of threads
+	static void ReadObjFile(const std::string& fileName, std::vector<Mesh::Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer,
+		const VertexFormat& vertexFormat = VertexFormat{}, bool canReorderTriangles = false, uint32_t threadCount = 0);
 private:
 	struct Face
 	{
@@ -15,9 +25,45 @@ private:
 		int vt0, vt1, vt2;
 		int vn0, vn1, vn2;
 	};
-	static bool IsVertex(const std::string& line, Elite::FPoint3& vertex);
-	static bool IsUV(const std::string& line, Elite::FPoint3& uv);
-	static bool IsNormal(const std::string& line, Elite::FPoint3& normal);
-	static bool IsFace(const std::string& line, Face& face);
+	//Identifies a unique vertex by the exact bits of its position, uv and normal, with -0 folded into +0
+	//Unlike Vertex_Input::operator==, which compares with an epsilon, values that differ in their last bits are not welded
+	//Obj files often repeat the same value under different indices, so keying on the v/vt/vn indices would not weld those
+	using VertexKey = FloatKey<8>;
+	using VertexKeyHash = VertexKey::Hash;
+	static VertexKey GetVertexKey(const Mesh::Vertex_Input& vertex);
+	//Part of the file that is parsed by a single thread
+	struct Chunk
+	{
+		std::string_view text;
+
+		std::vector<Elite::FPoint3> positions;
+		std::vector<Elite::FPoint3> uvs;
+		std::vector<Elite::FPoint3> normals;
+		std::vector<Face> faces;
+
+		//Unique vertices of this chunk, indices point into these and remap maps them to the final vertex buffer
+		std::vector<Mesh::Vertex_Input> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> remap;
+	};
+	//Small files are not worth splitting up
+	static const size_t m_MinChunkSize{ 256 * 1024 };
+
+	static void ParseChunk(Chunk& chunk);
+	static void ResolveChunkFaces(Chunk& chunk, const std::vector<Elite::FPoint3>& posBuffer, const std::vector<Elite::FPoint3>& uvBuffer, const std::vector<Elite::FPoint3>& normalBuffer,
+		const VertexFormat& vertexFormat);
+	static void RunParallel(size_t count, const std::function<void(size_t)>& task);
+	static uint32_t AddVertex(const Mesh::Vertex_Input& vertex, std::vector<Mesh::Vertex_Input>& vertexBuffer, std::unordered_map<VertexKey, uint32_t, VertexKeyHash>& vertexLookup);
+	//Lines are views straight into the mapped file, the Read helpers consume what they parsed from the front of the view
+	static bool IsVertex(std::string_view line, Elite::FPoint3& vertex);
+	static bool IsUV(std::string_view line, Elite::FPoint3& uv);
+	static bool IsNormal(std::string_view line, Elite::FPoint3& normal);
+	static bool IsFace(std::string_view line, Face& face);
+
+	static bool ReadKeyword(std::string_view& line, std::string_view keyword);
+	//Floats and indices, skips the whitespace in front of the number
+	template<typename NumberType>
+	static bool ReadNumber(std::string_view& line, NumberType& value);
+	static bool ReadFaceVertex(std::string_view& line, int& v, int& vt, int& vn);
 };
 
@@ -0,0 +1,366 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <numeric>
+
+float MeshSimplifier::Simplify(const Mesh::PositionStreams& positions, std::vector<uint32_t>& indexBuffer, size_t targetIndexCount)
+{
+	//Collapses work on positions, every vertex is represented by the first vertex with the same position
+	const std::vector<uint32_t>& ids{ positions.WeldedIds };
+	const size_t vertexCount{ positions.X.size() };
+	const size_t targetTriangleCount{ targetIndexCount / 3 };
+
+	std::vector<Quadric> quadrics{};
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacentTriangles{};
+	std::vector<uint32_t> fillOffsets{};
+	std::unordered_map<uint64_t, uint32_t> edgeUses{};
+	std::vector<Collapse> collapses{};
+	std::vector<uint8_t> isBorder(vertexCount);
+	std::vector<uint8_t> isLocked(vertexCount);
+	std::vector<uint32_t> vertexRemap(vertexCount);
+	float maxError{};
+
+	//Every pass collapses a set of edges that don't share any triangles, then the adjacency is rebuilt
+	while (indexBuffer.size() / 3 > targetTriangleCount)
+	{
+		const size_t triangleCount{ indexBuffer.size() / 3 };
+
+		//Triangles adjacent to every position, adjacentTriangles[triangleOffsets[id] .. triangleOffsets[id + 1]]
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : indexBuffer) triangleOffsets[ids[index] + 1]++;
+		std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+		adjacentTriangles.resize(indexBuffer.size());
+		fillOffsets.assign(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < indexBuffer.size(); i++)
+		{
+			adjacentTriangles[fillOffsets[ids[indexBuffer[i]]]++] = uint32_t(i / 3);
+		}
+
+		edgeUses.clear();
+		for (size_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				edgeUses[GetEdgeKey(ids[indexBuffer[triangle * 3 + corner]], ids[indexBuffer[triangle * 3 + (corner + 1) % 3]])]++;
+			}
+		}
+		//1 is an open border, 2 a non manifold edge, positions on those never move
+		std::fill(isBorder.begin(), isBorder.end(), uint8_t(0));
+		for (const std::pair<const uint64_t, uint32_t>& edge : edgeUses)
+		{
+			if (edge.second == 2) continue;
+
+			const uint8_t border{ edge.second == 1 ? uint8_t(1) : uint8_t(2) };
+			const uint32_t a{ uint32_t(edge.first >> 32) }, b{ uint32_t(edge.first) };
+			isBorder[a] = std::max(isBorder[a], border);
+			isBorder[b] = std::max(isBorder[b], border);
+		}
+
+		//The quadrics describe the original surface, collapsed positions keep the planes of everything they replaced
+		if (quadrics.empty()) CalculateQuadrics(positions, indexBuffer, edgeUses, quadrics);
+
+		collapses.clear();
+		for (size_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t a{ ids[indexBuffer[triangle * 3 + corner]] };
+				const uint32_t b{ ids[indexBuffer[triangle * 3 + (corner + 1) % 3]] };
+				const bool isBorderEdge{ edgeUses[GetEdgeKey(a, b)] == 1 };
+				//Inner edges are shared by two triangles with opposite winding, only one of them adds the edge
+				if (a == b || (a > b && !isBorderEdge)) continue;
+
+				Quadric quadric{ quadrics[a] };
+				quadric.Add(quadrics[b]);
+				const uint32_t ends[2]{ a, b };
+				for (int end = 0; end < 2; end++)
+				{
+					const uint32_t from{ ends[end] }, to{ ends[1 - end] };
+					//Border positions may only slide along the border, onto another border position
+					if (isBorder[from] == 2 || (isBorder[from] == 1 && (!isBorderEdge || isBorder[to] != 1))) continue;
+
+					const double error{ quadric.Evaluate(positions.X[to], positions.Y[to], positions.Z[to]) / std::max(quadric.weight, DBL_MIN) };
+					collapses.push_back(Collapse{ from, to, float(error) });
+				}
+			}
+		}
+		if (collapses.empty())
+			break;
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		//Most collapses remove two triangles, the pass stops at the cost of the last collapse that would still be needed
+		//Without the limit a pass would fall through to expensive collapses while cheaper ones are only locked until the next pass
+		const size_t collapseGoal{ std::max((triangleCount - targetTriangleCount) / 2, size_t(1)) };
+		float costLimit{ collapses[std::min(collapseGoal, collapses.size()) - 1].cost };
+
+		//Cheapest collapses first, every collapse locks its neighbourhood so the adjacency stays valid for the rest of the pass
+		std::fill(isLocked.begin(), isLocked.end(), uint8_t(0));
+		std::iota(vertexRemap.begin(), vertexRemap.end(), 0);
+		size_t remainingTriangles{ triangleCount };
+		size_t amountCollapsed{};
+		for (size_t collapseIndex = 0; collapseIndex < collapses.size(); collapseIndex++)
+		{
+			const Collapse& collapse{ collapses[collapseIndex] };
+			if (remainingTriangles <= targetTriangleCount || (collapse.cost > costLimit && amountCollapsed > 0))
+				break;
+			if (isLocked[collapse.from] || isLocked[collapse.to]) continue;
+			if (!CanCollapse(positions, indexBuffer, triangleOffsets, adjacentTriangles, collapse, vertexRemap)) continue;
+
+			//None of the collapses below the limit were valid, the limit moves up from here so the simplification doesn't stall
+			if (collapse.cost > costLimit) costLimit = collapses[std::min(collapseIndex + collapseGoal, collapses.size()) - 1].cost;
+
+			const uint32_t ends[2]{ collapse.from, collapse.to };
+			for (uint32_t end : ends)
+			{
+				for (uint32_t i = triangleOffsets[end]; i < triangleOffsets[end + 1]; i++)
+				{
+					const uint32_t triangle{ adjacentTriangles[i] };
+					//Triangles around from that hold to as well degenerate
+					bool isRemoved{ false };
+					for (size_t corner = 0; corner < 3; corner++)
+					{
+						const uint32_t id{ ids[indexBuffer[triangle * 3 + corner]] };
+						isLocked[id] = 1;
+						if (end == collapse.from && id == collapse.to) isRemoved = true;
+					}
+					if (isRemoved) remainingTriangles--;
+				}
+			}
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			maxError = std::max(maxError, collapse.cost);
+			amountCollapsed++;
+		}
+		if (amountCollapsed == 0)
+			break;
+
+		//Triangles around the collapsed edges degenerate and are dropped
+		size_t writeIndex{};
+		for (size_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			const uint32_t i0{ vertexRemap[indexBuffer[triangle * 3]] };
+			const uint32_t i1{ vertexRemap[indexBuffer[triangle * 3 + 1]] };
+			const uint32_t i2{ vertexRemap[indexBuffer[triangle * 3 + 2]] };
+			if (ids[i0] == ids[i1] || ids[i1] == ids[i2] || ids[i2] == ids[i0]) continue;
+
+			indexBuffer[writeIndex++] = i0;
+			indexBuffer[writeIndex++] = i1;
+			indexBuffer[writeIndex++] = i2;
+		}
+		indexBuffer.resize(writeIndex);
+	}
+
+	return sqrtf(maxError);
+}
+
+void MeshSimplifier::Quadric::AddPlane(double a, double b, double c, double d, double planeWeight)
+{
+	a2 += planeWeight * a * a;
+	ab += planeWeight * a * b;
+	ac += planeWeight * a * c;
+	ad += planeWeight * a * d;
+	b2 += planeWeight * b * b;
+	bc += planeWeight * b * c;
+	bd += planeWeight * b * d;
+	c2 += planeWeight * c * c;
+	cd += planeWeight * c * d;
+	d2 += planeWeight * d * d;
+	weight += planeWeight;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric& other)
+{
+	a2 += other.a2;
+	ab += other.ab;
+	ac += other.ac;
+	ad += other.ad;
+	b2 += other.b2;
+	bc += other.bc;
+	bd += other.bd;
+	c2 += other.c2;
+	cd += other.cd;
+	d2 += other.d2;
+	weight += other.weight;
+}
+
+double MeshSimplifier::Quadric::Evaluate(double x, double y, double z) const
+{
+	//p^T * A * p + 2 * b^T * p + c, rounding can push it slightly below zero
+	const double error{ a2 * x * x + b2 * y * y + c2 * z * z + 2 * (ab * x * y + ac * x * z + bc * y * z) + 2 * (ad * x + bd * y + cd * z) + d2 };
+	return std::max(error, 0.0);
+}
+
+void MeshSimplifier::CalculateQuadrics(const Mesh::PositionStreams& positions, const std::vector<uint32_t>& indexBuffer, const std::unordered_map<uint64_t, uint32_t>& edgeUses,
+	std::vector<Quadric>& quadrics)
+{
+	const std::vector<uint32_t>& ids{ positions.WeldedIds };
+	quadrics.assign(positions.X.size(), Quadric{});
+	for (size_t i = 0; i < indexBuffer.size(); i += 3)
+	{
+		const uint32_t corners[3]{ ids[indexBuffer[i]], ids[indexBuffer[i + 1]], ids[indexBuffer[i + 2]] };
+		double p[3][3]{};
+		for (int corner = 0; corner < 3; corner++)
+		{
+			p[corner][0] = positions.X[corners[corner]];
+			p[corner][1] = positions.Y[corners[corner]];
+			p[corner][2] = positions.Z[corners[corner]];
+		}
+		const double e0[3]{ p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+		const double e1[3]{ p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+		double normal[3]{ e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+		const double length{ sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]) };
+		if (length == 0.0) continue;
+
+		for (double& axis : normal) axis /= length;
+		const double d{ -(normal[0] * p[0][0] + normal[1] * p[0][1] + normal[2] * p[0][2]) };
+		for (uint32_t corner : corners) quadrics[corner].AddPlane(normal[0], normal[1], normal[2], d, length / 2.0);
+
+		//Open borders get a plane through the edge, perpendicular to the triangle, so they can't move inwards
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const int next{ (corner + 1) % 3 };
+			const std::unordered_map<uint64_t, uint32_t>::const_iterator it{ edgeUses.find(GetEdgeKey(corners[corner], corners[next])) };
+			if (it == edgeUses.end() || it->second != 1) continue;
+
+			const double edge[3]{ p[next][0] - p[corner][0], p[next][1] - p[corner][1], p[next][2] - p[corner][2] };
+			double borderNormal[3]{ edge[1] * normal[2] - edge[2] * normal[1], edge[2] * normal[0] - edge[0] * normal[2], edge[0] * normal[1] - edge[1] * normal[0] };
+			const double edgeLength{ sqrt(borderNormal[0] * borderNormal[0] + borderNormal[1] * borderNormal[1] + borderNormal[2] * borderNormal[2]) };
+			if (edgeLength == 0.0) continue;
+
+			for (double& axis : borderNormal) axis /= edgeLength;
+			const double borderD{ -(borderNormal[0] * p[corner][0] + borderNormal[1] * p[corner][1] + borderNormal[2] * p[corner][2]) };
+			const double borderWeight{ edgeLength * edgeLength * m_BorderWeight };
+			quadrics[corners[corner]].AddPlane(borderNormal[0], borderNormal[1], borderNormal[2], borderD, borderWeight);
+			quadrics[corners[next]].AddPlane(borderNormal[0], borderNormal[1], borderNormal[2], borderD, borderWeight);
+		}
+	}
+}
+
+bool MeshSimplifier::CanCollapse(const Mesh::PositionStreams& positions, const std::vector<uint32_t>& indexBuffer, const std::vector<uint32_t>& triangleOffsets,
+	const std::vector<uint32_t>& adjacentTriangles, const Collapse& collapse, std::vector<uint32_t>& vertexRemap)
+{
+	const std::vector<uint32_t>& ids{ positions.WeldedIds };
+	const uint32_t from{ collapse.from }, to{ collapse.to };
+
+	//Vertex of from and the vertex of to it shares a removed triangle with, collapsing those onto each other keeps seams intact
+	std::vector<std::pair<uint32_t, uint32_t>> vertexPairs{};
+	std::vector<std::pair<uint32_t, Elite::FVector3>> fromFans{};
+	std::vector<std::pair<uint32_t, Elite::FVector3>> toFans{};
+	std::vector<uint32_t> fromNeighbours{};
+	std::vector<uint32_t> toNeighbours{};
+	std::vector<uint32_t> opposites{};
+	for (uint32_t i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+	{
+		const uint32_t* pTriangle{ &indexBuffer[adjacentTriangles[i] * 3] };
+		int fromCorner{ -1 }, toCorner{ -1 };
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (ids[pTriangle[corner]] == from) fromCorner = corner;
+			else if (ids[pTriangle[corner]] == to) toCorner = corner;
+			else fromNeighbours.push_back(ids[pTriangle[corner]]);
+		}
+		const Elite::FVector3 before{ GetTriangleNormal(positions, ids[pTriangle[0]], ids[pTriangle[1]], ids[pTriangle[2]]) };
+		AddFanNormal(fromFans, pTriangle[fromCorner], before);
+
+		if (toCorner >= 0)
+		{
+			vertexPairs.emplace_back(pTriangle[fromCorner], pTriangle[toCorner]);
+			opposites.push_back(ids[pTriangle[3 - fromCorner - toCorner]]);
+			continue;
+		}
+
+		//The triangles that stay may not flip
+		uint32_t moved[3]{ ids[pTriangle[0]], ids[pTriangle[1]], ids[pTriangle[2]] };
+		moved[fromCorner] = to;
+		if (Elite::Dot(before, GetTriangleNormal(positions, moved[0], moved[1], moved[2])) <= 0.f)
+			return false;
+	}
+
+	for (uint32_t i = triangleOffsets[to]; i < triangleOffsets[to + 1]; i++)
+	{
+		const uint32_t* pTriangle{ &indexBuffer[adjacentTriangles[i] * 3] };
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const uint32_t id{ ids[pTriangle[corner]] };
+			if (id == to) AddFanNormal(toFans, pTriangle[corner], GetTriangleNormal(positions, ids[pTriangle[0]], ids[pTriangle[1]], ids[pTriangle[2]]));
+			else if (id != from) toNeighbours.push_back(id);
+		}
+	}
+
+	//Link condition: from and to may only share the neighbours opposite to their common edge, otherwise the collapse pinches the surface
+	std::sort(fromNeighbours.begin(), fromNeighbours.end());
+	fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+	std::sort(toNeighbours.begin(), toNeighbours.end());
+	toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+	std::sort(opposites.begin(), opposites.end());
+	opposites.erase(std::unique(opposites.begin(), opposites.end()), opposites.end());
+	std::vector<uint32_t> shared{};
+	std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), std::back_inserter(shared));
+	if (shared.size() > opposites.size())
+		return false;
+
+	//A vertex of from that touches two different vertices of to sits on the end of a seam, collapsing it would tear the seam open
+	std::sort(vertexPairs.begin(), vertexPairs.end());
+	vertexPairs.erase(std::unique(vertexPairs.begin(), vertexPairs.end()), vertexPairs.end());
+	for (size_t i = 1; i < vertexPairs.size(); i++)
+	{
+		if (vertexPairs[i].first == vertexPairs[i - 1].first)
+			return false;
+	}
+
+	//Vertices of from that don't touch to (hard edges, faceted surfaces) move onto the vertex of to that faces the same way
+	for (const std::pair<uint32_t, Elite::FVector3>& fromFan : fromFans)
+	{
+		std::vector<std::pair<uint32_t, uint32_t>>::const_iterator it{ std::lower_bound(vertexPairs.begin(), vertexPairs.end(), std::make_pair(fromFan.first, 0u)) };
+		if (it != vertexPairs.end() && it->first == fromFan.first)
+		{
+			vertexRemap[fromFan.first] = it->second;
+			continue;
+		}
+
+		float bestDot{ -FLT_MAX };
+		for (const std::pair<uint32_t, Elite::FVector3>& toFan : toFans)
+		{
+			const float dot{ Elite::Dot(SafeNormalize(fromFan.second), SafeNormalize(toFan.second)) };
+			if (dot > bestDot)
+			{
+				bestDot = dot;
+				vertexRemap[fromFan.first] = toFan.first;
+			}
+		}
+	}
+	return true;
+}
+
+void MeshSimplifier::AddFanNormal(std::vector<std::pair<uint32_t, Elite::FVector3>>& fans, uint32_t vertex, const Elite::FVector3& normal)
+{
+	for (std::pair<uint32_t, Elite::FVector3>& fan : fans)
+	{
+		if (fan.first != vertex) continue;
+
+		fan.second += normal;
+		return;
+	}
+	fans.emplace_back(vertex, normal);
+}
+
+Elite::FVector3 MeshSimplifier::GetTriangleNormal(const Mesh::PositionStreams& positions, uint32_t i0, uint32_t i1, uint32_t i2)
+{
+	const Elite::FPoint3 p0{ positions.X[i0], positions.Y[i0], positions.Z[i0] };
+	const Elite::FPoint3 p1{ positions.X[i1], positions.Y[i1], positions.Z[i1] };
+	const Elite::FPoint3 p2{ positions.X[i2], positions.Y[i2], positions.Z[i2] };
+	return Elite::Cross(p1 - p0, p2 - p0);
+}
+
+uint64_t MeshSimplifier::GetEdgeKey(uint32_t a, uint32_t b)
+{
+	if (a > b) std::swap(a, b);
+	return (uint64_t(a) << 32) | b;
+}
+
+Elite::FVector3 MeshSimplifier::SafeNormalize(const Elite::FVector3& vector)
+{
+	const float length{ Elite::Magnitude(vector) };
+	if (!(length > 0.f)) return Elite::FVector3{};
+	return vector / length;
+}
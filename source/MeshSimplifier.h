@@ -0,0 +1,52 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "Mesh.h"
+
+//Reduces the triangle count of an index buffer by collapsing edges, the vertex buffer is left untouched
+//Based on "Surface Simplification Using Quadric Error Metrics" (Garland, Heckbert 1997), vertices only collapse onto existing vertices
+class MeshSimplifier final
+{
+public:
+	//Collapses edges in order of their quadric error until indexBuffer has at most targetIndexCount indices or no edge can be collapsed anymore
+	//Vertices that are split along uv or normal seams collapse together, so seams stay closed, open borders only collapse along the border
+	//Returns the largest error of all collapses, as a distance in object space
+	static float Simplify(const Mesh::PositionStreams& positions, std::vector<uint32_t>& indexBuffer, size_t targetIndexCount);
+private:
+	MeshSimplifier() = default;
+
+	//Sum of squared distances to a set of planes, weighted by the area of the triangles they come from
+	struct Quadric
+	{
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+		double weight;
+
+		void AddPlane(double a, double b, double c, double d, double planeWeight);
+		void Add(const Quadric& other);
+		double Evaluate(double x, double y, double z) const;
+	};
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float cost;
+	};
+
+	//Border edges weigh this much more than the surface, so borders keep their shape
+	static constexpr double m_BorderWeight{ 10.0 };
+
+	//edgeUses holds how many triangles use every edge, edges used once are borders
+	static void CalculateQuadrics(const Mesh::PositionStreams& positions, const std::vector<uint32_t>& indexBuffer, const std::unordered_map<uint64_t, uint32_t>& edgeUses,
+		std::vector<Quadric>& quadrics);
+	//Checks if the collapse keeps seams closed, flips no triangles and keeps the mesh manifold, only then the vertices of collapse.from are remapped onto vertices of collapse.to
+	static bool CanCollapse(const Mesh::PositionStreams& positions, const std::vector<uint32_t>& indexBuffer, const std::vector<uint32_t>& triangleOffsets,
+		const std::vector<uint32_t>& adjacentTriangles, const Collapse& collapse, std::vector<uint32_t>& vertexRemap);
+	//Sums the normals of the triangles around every vertex of a position
+	static void AddFanNormal(std::vector<std::pair<uint32_t, Elite::FVector3>>& fans, uint32_t vertex, const Elite::FVector3& normal);
+	//Not normalized, weighted by the area of the triangle
+	static Elite::FVector3 GetTriangleNormal(const Mesh::PositionStreams& positions, uint32_t i0, uint32_t i1, uint32_t i2);
+	//Zero vector stays zero
+	static Elite::FVector3 SafeNormalize(const Elite::FVector3& vector);
+	static uint64_t GetEdgeKey(uint32_t a, uint32_t b);
+};
+
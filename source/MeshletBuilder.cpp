@@ -0,0 +1,260 @@
+#include "pch.h"
+#include "MeshletBuilder.h"
+#include <numeric>
+
+void MeshletBuilder::Build(const Mesh::PositionStreams& positions, std::vector<uint32_t>& indexBuffer, std::vector<Mesh::Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices,
+	bool canReorderTriangles)
+{
+	meshlets.clear();
+	meshletVertices.clear();
+	const size_t vertexCount{ positions.X.size() };
+	const size_t triangleCount{ indexBuffer.size() / 3 };
+	if (triangleCount == 0)
+		return;
+
+	if (!canReorderTriangles)
+	{
+		SplitInOrder(vertexCount, indexBuffer, meshlets, meshletVertices);
+		for (Mesh::Meshlet& meshlet : meshlets)
+		{
+			CalculateBounds(positions, meshletVertices, meshlet);
+			CalculateCone(positions, indexBuffer, meshlet);
+		}
+		return;
+	}
+
+	//Vertices are split along uv and normal seams, triangles on both sides of a seam are still neighbours
+	const std::vector<uint32_t>& positionIds{ positions.WeldedIds };
+
+	//Triangles adjacent to every position, adjacentTriangles[triangleOffsets[id] .. triangleOffsets[id + 1]]
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) triangleOffsets[positionIds[indexBuffer[i]] + 1]++;
+	std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+
+	std::vector<uint32_t> adjacentTriangles(triangleCount * 3);
+	std::vector<uint32_t> fillOffsets(triangleOffsets.begin(), triangleOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacentTriangles[fillOffsets[positionIds[indexBuffer[i]]]++] = uint32_t(i / 3);
+	}
+
+	std::vector<Elite::FVector3> triangleNormals(triangleCount);
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		triangleNormals[triangle] = GetTriangleNormal(positions, &indexBuffer[triangle * 3]);
+	}
+
+	//Meshlet that last used every vertex, so checking if a vertex is already in the current meshlet needs no lookup table
+	const uint32_t noMeshlet{ UINT32_MAX };
+	std::vector<uint32_t> vertexMeshlet(vertexCount, noMeshlet);
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<uint32_t> candidates{};
+	std::vector<uint32_t> output{};
+	output.reserve(triangleCount * 3);
+	uint32_t cursor{ 0 };
+
+	while (true)
+	{
+		while (cursor < triangleCount && isEmitted[cursor]) cursor++;
+		if (cursor == triangleCount)
+			break;
+
+		const uint32_t meshletIndex{ uint32_t(meshlets.size()) };
+		Mesh::Meshlet meshlet{};
+		meshlet.FirstIndex = uint32_t(output.size());
+		meshlet.FirstVertex = uint32_t(meshletVertices.size());
+		Elite::FVector3 normalSum{};
+		candidates.clear();
+
+		//Grows the meshlet from the first triangle that is left, adding the neighbour that costs the least new vertices and widens the normal cone the least
+		int64_t next{ cursor };
+		while (next >= 0)
+		{
+			const uint32_t triangle{ uint32_t(next) };
+			isEmitted[triangle] = true;
+			normalSum += triangleNormals[triangle];
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t v{ indexBuffer[triangle * 3 + corner] };
+				output.push_back(v);
+				if (vertexMeshlet[v] == meshletIndex) continue;
+
+				vertexMeshlet[v] = meshletIndex;
+				meshletVertices.push_back(v);
+				meshlet.AmountVertices++;
+				const uint32_t id{ positionIds[v] };
+				for (uint32_t i = triangleOffsets[id]; i < triangleOffsets[id + 1]; i++)
+				{
+					if (!isEmitted[adjacentTriangles[i]]) candidates.push_back(adjacentTriangles[i]);
+				}
+			}
+			meshlet.AmountIndices += 3;
+			if (meshlet.AmountIndices / 3 == m_MaxTriangles)
+				break;
+
+			const Elite::FVector3 axis{ SafeNormalize(normalSum) };
+			next = -1;
+			float bestScore{ FLT_MAX };
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				const uint32_t candidate{ candidates[i] };
+				if (isEmitted[candidate])
+				{
+					//Already added through another vertex, drop it from the list
+					candidates[i--] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+
+				uint32_t newVertices{};
+				for (size_t corner = 0; corner < 3; corner++)
+				{
+					if (vertexMeshlet[indexBuffer[candidate * 3 + corner]] != meshletIndex) newVertices++;
+				}
+				if (meshlet.AmountVertices + newVertices > m_MaxVertices) continue;
+
+				const float score{ float(newVertices) + m_ConeWeight * (1.f - Elite::Dot(axis, triangleNormals[candidate])) };
+				if (score < bestScore)
+				{
+					bestScore = score;
+					next = candidate;
+				}
+			}
+
+			//No neighbour fits, continue with the next triangle in index order if it still fits
+			if (next < 0)
+			{
+				while (cursor < triangleCount && isEmitted[cursor]) cursor++;
+				if (cursor < triangleCount && meshlet.AmountVertices + 3 <= m_MaxVertices) next = cursor;
+			}
+		}
+
+		meshlets.push_back(meshlet);
+	}
+
+	indexBuffer.swap(output);
+	for (Mesh::Meshlet& meshlet : meshlets)
+	{
+		CalculateBounds(positions, meshletVertices, meshlet);
+		CalculateCone(positions, indexBuffer, meshlet);
+	}
+}
+
+void MeshletBuilder::SplitInOrder(size_t vertexCount, const std::vector<uint32_t>& indexBuffer, std::vector<Mesh::Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices)
+{
+	//Meshlet that last used every vertex, like in Build
+	const uint32_t noMeshlet{ UINT32_MAX };
+	std::vector<uint32_t> vertexMeshlet(vertexCount, noMeshlet);
+	for (size_t triangle = 0; triangle < indexBuffer.size() / 3; triangle++)
+	{
+		const uint32_t* pIndices{ &indexBuffer[triangle * 3] };
+		uint32_t newVertices{};
+		if (!meshlets.empty())
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				if (vertexMeshlet[pIndices[corner]] != meshlets.size() - 1) newVertices++;
+			}
+		}
+
+		//The next meshlet starts where the current one is full
+		if (meshlets.empty() || meshlets.back().AmountIndices / 3 == m_MaxTriangles || meshlets.back().AmountVertices + newVertices > m_MaxVertices)
+		{
+			Mesh::Meshlet meshlet{};
+			meshlet.FirstIndex = uint32_t(triangle * 3);
+			meshlet.FirstVertex = uint32_t(meshletVertices.size());
+			meshlets.push_back(meshlet);
+		}
+
+		Mesh::Meshlet& meshlet{ meshlets.back() };
+		const uint32_t meshletIndex{ uint32_t(meshlets.size() - 1) };
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			const uint32_t v{ pIndices[corner] };
+			if (vertexMeshlet[v] == meshletIndex) continue;
+
+			vertexMeshlet[v] = meshletIndex;
+			meshletVertices.push_back(v);
+			meshlet.AmountVertices++;
+		}
+		meshlet.AmountIndices += 3;
+	}
+}
+
+void MeshletBuilder::CalculateBounds(const Mesh::PositionStreams& positions, const std::vector<uint32_t>& meshletVertices, Mesh::Meshlet& meshlet)
+{
+	//Sphere around the center of the bounding box, not the smallest possible one but cheap and close enough for culling
+	Elite::FPoint3 boundsMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Elite::FPoint3 boundsMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t i = meshlet.FirstVertex; i < meshlet.FirstVertex + meshlet.AmountVertices; i++)
+	{
+		const uint32_t vertex{ meshletVertices[i] };
+		const Elite::FPoint3 position{ positions.X[vertex], positions.Y[vertex], positions.Z[vertex] };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			boundsMin.data[axis] = std::min(boundsMin.data[axis], position.data[axis]);
+			boundsMax.data[axis] = std::max(boundsMax.data[axis], position.data[axis]);
+		}
+	}
+	meshlet.Center = Elite::FPoint3{ (boundsMin.x + boundsMax.x) / 2.f, (boundsMin.y + boundsMax.y) / 2.f, (boundsMin.z + boundsMax.z) / 2.f };
+
+	float radiusSquared{};
+	for (uint32_t i = meshlet.FirstVertex; i < meshlet.FirstVertex + meshlet.AmountVertices; i++)
+	{
+		const uint32_t vertex{ meshletVertices[i] };
+		const Elite::FPoint3 position{ positions.X[vertex], positions.Y[vertex], positions.Z[vertex] };
+		radiusSquared = std::max(radiusSquared, Elite::SqrMagnitude(position - meshlet.Center));
+	}
+	meshlet.Radius = sqrtf(radiusSquared);
+}
+
+void MeshletBuilder::CalculateCone(const Mesh::PositionStreams& positions, const std::vector<uint32_t>& indexBuffer, Mesh::Meshlet& meshlet)
+{
+	std::vector<Elite::FVector3> normals{};
+	normals.reserve(meshlet.AmountIndices / 3);
+	Elite::FVector3 axis{};
+	for (uint32_t i = meshlet.FirstIndex; i < meshlet.FirstIndex + meshlet.AmountIndices; i += 3)
+	{
+		const Elite::FVector3 normal{ GetTriangleNormal(positions, &indexBuffer[i]) };
+		//Degenerate triangles are never rasterized, they don't widen the cone
+		if (Elite::SqrMagnitude(normal) == 0.f) continue;
+
+		normals.push_back(normal);
+		axis += normal;
+	}
+
+	meshlet.ConeAxis = Elite::FVector3{};
+	meshlet.ConeCutoff = 1.f;
+	if (normals.empty())
+		return;
+
+	meshlet.ConeAxis = SafeNormalize(axis);
+	float minDot{ 1.f };
+	for (const Elite::FVector3& normal : normals)
+	{
+		minDot = std::min(minDot, Elite::Dot(meshlet.ConeAxis, normal));
+	}
+
+	//The normals spread too far for the cone to reject enough view directions to be worth testing
+	if (minDot < m_MinConeDot)
+		return;
+
+	meshlet.ConeCutoff = sqrtf(1.f - minDot * minDot);
+}
+
+Elite::FVector3 MeshletBuilder::GetTriangleNormal(const Mesh::PositionStreams& positions, const uint32_t* pIndices)
+{
+	//Same winding as Triangle::GetTriangleNormal, so the cones agree with the per triangle culling
+	const uint32_t i0{ pIndices[0] }, i1{ pIndices[1] }, i2{ pIndices[2] };
+	const Elite::FPoint3 p0{ positions.X[i0], positions.Y[i0], positions.Z[i0] };
+	const Elite::FPoint3 p1{ positions.X[i1], positions.Y[i1], positions.Z[i1] };
+	const Elite::FPoint3 p2{ positions.X[i2], positions.Y[i2], positions.Z[i2] };
+	return SafeNormalize(Elite::Cross(p1 - p0, p2 - p0));
+}
+
+Elite::FVector3 MeshletBuilder::SafeNormalize(const Elite::FVector3& vector)
+{
+	const float length{ Elite::Magnitude(vector) };
+	if (!(length > 0.f)) return Elite::FVector3{};
+	return vector / length;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include "Mesh.h"
+
+//Splits the index buffer of a mesh into meshlets of connected triangles, preferring similar normals, and calculates their bounding spheres and normal cones
+class MeshletBuilder final
+{
+public:
+	//Replaces the contents of meshlets and meshletVertices
+	//The triangles of indexBuffer are reordered so every meshlet is a consecutive range, the meshlets themselves follow the original order where they start
+	//Without canReorderTriangles the triangles keep their order and every meshlet is the next run of triangles that fits, for blended meshes
+	static void Build(const Mesh::PositionStreams& positions, std::vector<uint32_t>& indexBuffer, std::vector<Mesh::Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices,
+		bool canReorderTriangles = true);
+private:
+	MeshletBuilder() = default;
+
+	static void SplitInOrder(size_t vertexCount, const std::vector<uint32_t>& indexBuffer, std::vector<Mesh::Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices);
+
+	static const uint32_t m_MaxTriangles{ 128 };
+	static const uint32_t m_MaxVertices{ 96 };
+	//How much a candidate triangle is penalized for widening the normal cone, compared to one extra vertex
+	static constexpr float m_ConeWeight{ 4.f };
+	//Meshlets always grow up to m_MaxTriangles, one with a normal more than 60 degrees away from its cone axis isn't cone tested, only its bounds are
+	//Small meshlets would cost more per meshlet culling and transforms than a cone test can save
+	static constexpr float m_MinConeDot{ 0.5f };
+
+	static void CalculateBounds(const Mesh::PositionStreams& positions, const std::vector<uint32_t>& meshletVertices, Mesh::Meshlet& meshlet);
+	static void CalculateCone(const Mesh::PositionStreams& positions, const std::vector<uint32_t>& indexBuffer, Mesh::Meshlet& meshlet);
+	static Elite::FVector3 GetTriangleNormal(const Mesh::PositionStreams& positions, const uint32_t* pIndices);
+	//Zero vector stays zero
+	static Elite::FVector3 SafeNormalize(const Elite::FVector3& vector);
+};
+
@@ -1,8 +1,7 @@
 //-----------------------------------
 // Global variables
 //-----------------------------------
-float4x4 gWorldViewProj : WorldViewProjection;
-float4x4 gWorld : WORLD;
+float4x4 gViewProj : ViewProjection;
 float4x4 gViewInverse : VIEWINVERSE;
 
 Texture2D gDiffuseMap : DiffuseMap;
@@ -10,6 +9,11 @@ Texture2D gNormalMap : NormalMap;
 Texture2D gSpecularMap : SpecularMap;
 Texture2D gGlossinessMap : GlossinessMap;
 
+// Compact vertex decode (see VertexFormat)
+float4 gPositionScale : POSITIONSCALE;
+float4 gPositionOffset : POSITIONOFFSET;
+float4 gUVDecode : UVDECODE;
+
 static const float3 gLightDirection = { 0.577f,-0.577f,0.577f };
 static const float PI = 3.14;
 static const float gLightIntensity = 2.0f;
@@ -66,13 +70,30 @@ DepthStencilState gDepthStencilState
 //	Input/Output Structs
 //-----------------------------------
 
+//Only the attributes of the mesh's VertexFormat are defined (VERTEX_COLOR, VERTEX_UV, ...)
+//COMPACT_VERTEX stores quantized positions and uvs and octahedral encoded normals and tangents
 struct VS_INPUT
 {
 	float3 Position : POSITION;
+#ifdef VERTEX_COLOR
 	float3 Color : COLOR;
+#endif
+#ifdef VERTEX_UV
 	float2 Tex : TEXCOORD0;
+#endif
+#ifdef COMPACT_VERTEX
+	float2 Normal : NORMAL;
+	float2 Tangent : TANGENT;
+#else
 	float3 Normal : NORMAL;
 	float3 Tangent : TANGENT;
+#endif
+	//Per instance, see Mesh::Instance
+	float4 WorldRow0 : WORLD0;
+	float4 WorldRow1 : WORLD1;
+	float4 WorldRow2 : WORLD2;
+	float4 WorldRow3 : WORLD3;
+	float4 Tint : TINT;
 };
 
 struct VS_OUTPUT
@@ -83,22 +104,50 @@ struct VS_OUTPUT
 	float2 Tex : TEXCOORD0;
 	float3 Normal : NORMAL;
 	float3 Tangent : TANGENT;
+	float3 Tint : TINT;
 };
 
+//-----------------------------------
+// Compact vertex decoding
+//-----------------------------------
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 direction = float3(encoded, 1.f - abs(encoded.x) - abs(encoded.y));
+	float fold = saturate(-direction.z);
+	direction.xy += (direction.xy >= 0.f) ? -fold : fold;
+	return normalize(direction);
+}
+
 //------------------------------------
 //	Vertex Shader
 //------------------------------------
 VS_OUTPUT VS(VS_INPUT input)
 {
 	VS_OUTPUT output = (VS_OUTPUT)0;
-	output.Position = float4(input.Position, 1.f);
-	output.Position = mul(output.Position, gWorldViewProj);
+	float4x4 world = float4x4(input.WorldRow0, input.WorldRow1, input.WorldRow2, input.WorldRow3);
+#ifdef COMPACT_VERTEX
+	float3 position = gPositionOffset.xyz + input.Position * gPositionScale.xyz;
+	output.Normal = mul(DecodeOctahedral(input.Normal), (float3x3)world);
+	output.Tangent = mul(DecodeOctahedral(input.Tangent), (float3x3)world);
+#else
+	float3 position = input.Position;
+	output.Normal = mul(normalize(input.Normal), (float3x3)world);
+	output.Tangent = mul(normalize(input.Tangent), (float3x3)world);
+#endif
+#ifdef VERTEX_COLOR
 	output.Color = input.Color;
+#endif
+#ifdef VERTEX_UV
+#ifdef COMPACT_VERTEX
+	output.Tex = gUVDecode.zw + input.Tex * gUVDecode.xy;
+#else
 	output.Tex = input.Tex;
-	output.Normal = mul(normalize(input.Normal), (float3x3)gWorld);
-	output.Tangent = mul(normalize(input.Tangent), (float3x3)gWorld);
-	output.WorldPosition = float4(input.Position, 1.f);
-	output.WorldPosition = mul(output.WorldPosition, gWorld);
+#endif
+#endif
+	output.WorldPosition = float4(position, 1.f);
+	output.WorldPosition = mul(output.WorldPosition, world);
+	output.Position = mul(output.WorldPosition, gViewProj);
+	output.Tint = input.Tint.rgb;
 	return output;
 }
 
@@ -171,7 +220,7 @@ float4 PS(VS_OUTPUT input, SamplerState samplerState) : SV_TARGET
 
 	float4 diffuseColor = GetDiffuse(input, samplerState) * phong;
 	float4 specularColor = GetSpecularColor(input, vertexNormal, samplerState);
-	return diffuseColor + specularColor;
+	return (diffuseColor + specularColor) * float4(input.Tint, 1.f);
 }
 
 float4 PS_Point(VS_OUTPUT input) : SV_TARGET
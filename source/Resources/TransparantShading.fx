@@ -1,10 +1,15 @@
 //-----------------------------------
 // Global variables
 //-----------------------------------
-float4x4 gWorldViewProj : WorldViewProjection;
+float4x4 gViewProj : ViewProjection;
 
 Texture2D gDiffuseMap : DiffuseMap;
 
+// Compact vertex decode (see VertexFormat)
+float4 gPositionScale : POSITIONSCALE;
+float4 gPositionOffset : POSITIONOFFSET;
+float4 gUVDecode : UVDECODE;
+
 // Global States
 RasterizerState gCullBack
 {
@@ -67,13 +72,23 @@ DepthStencilState gDepthStencilState
 //	Input/Output Structs
 //-----------------------------------
 
+//Only the attributes of the mesh's VertexFormat are defined (VERTEX_COLOR, VERTEX_UV, ...)
+//COMPACT_VERTEX stores quantized positions and uvs
 struct VS_INPUT
 {
 	float3 Position : POSITION;
+#ifdef VERTEX_COLOR
 	float3 Color : COLOR;
+#endif
+#ifdef VERTEX_UV
 	float2 Tex : TEXCOORD0;
-	float3 Normal : NORMAL;
-	float3 Tangent : TANGENT;
+#endif
+	//Per instance, see Mesh::Instance
+	float4 WorldRow0 : WORLD0;
+	float4 WorldRow1 : WORLD1;
+	float4 WorldRow2 : WORLD2;
+	float4 WorldRow3 : WORLD3;
+	float4 Tint : TINT;
 };
 
 struct VS_OUTPUT
@@ -81,6 +96,7 @@ struct VS_OUTPUT
 	float4 Position : SV_POSITION;
 	float3 Color : COLOR;
 	float2 Tex : TEXCOORD0;
+	float3 Tint : TINT;
 };
 
 
@@ -90,10 +106,25 @@ struct VS_OUTPUT
 VS_OUTPUT VS(VS_INPUT input)
 {
 	VS_OUTPUT output = (VS_OUTPUT)0;
-	output.Position = float4(input.Position, 1.f);
-	output.Position = mul(output.Position, gWorldViewProj);
+#ifdef COMPACT_VERTEX
+	float3 position = gPositionOffset.xyz + input.Position * gPositionScale.xyz;
+#else
+	float3 position = input.Position;
+#endif
+	float4x4 world = float4x4(input.WorldRow0, input.WorldRow1, input.WorldRow2, input.WorldRow3);
+	output.Position = float4(position, 1.f);
+	output.Position = mul(mul(output.Position, world), gViewProj);
+	output.Tint = input.Tint.rgb;
+#ifdef VERTEX_COLOR
 	output.Color = input.Color;
+#endif
+#ifdef VERTEX_UV
+#ifdef COMPACT_VERTEX
+	output.Tex = gUVDecode.zw + input.Tex * gUVDecode.xy;
+#else
 	output.Tex = input.Tex;
+#endif
+#endif
 	return output;
 }
 
@@ -128,7 +159,7 @@ float4 GetDiffuse(VS_OUTPUT input, SamplerState samplerState)
 
 float4 PS(VS_OUTPUT input, SamplerState samplerState) : SV_TARGET
 {
-	return GetDiffuse(input, samplerState);
+	return GetDiffuse(input, samplerState) * float4(input.Tint, 1.f);
 }
 
 float4 PS_Point(VS_OUTPUT input) : SV_TARGET
@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "SceneGraph.h"
+#include "StaticBatch.h"
+#include <algorithm>
 
 SceneGraph* SceneGraph::m_Instance{ nullptr };
 
@@ -18,9 +20,83 @@ SceneGraph::~SceneGraph()
 void SceneGraph::AddMesh(Mesh* pMesh)
 {
     m_Meshes.push_back(pMesh);
+    m_IsDirty = true;
+}
+
+uint32_t SceneGraph::AddInstance(Mesh* pMesh, const Elite::FMatrix4& world, const Elite::RGBColor& tint)
+{
+    if (std::find(m_Meshes.begin(), m_Meshes.end(), pMesh) == m_Meshes.end()) m_Meshes.push_back(pMesh);
+    m_IsDirty = true;
+
+    return pMesh->AddInstance(world, tint);
 }
 
 std::vector<Mesh*>& SceneGraph::GetMeshes()
 {
     return m_Meshes;
 }
+
+void SceneGraph::BatchStaticMeshes(ID3D11Device* pDevice)
+{
+    std::vector<Mesh*> meshes{};
+    std::vector<bool> isMerged(m_Meshes.size(), false);
+    for (size_t i = 0; i < m_Meshes.size(); i++)
+    {
+        if (isMerged[i]) continue;
+        Mesh* pFirst{ m_Meshes[i] };
+        if (!CanBatch(pFirst))
+        {
+            meshes.push_back(pFirst);
+            continue;
+        }
+
+        std::vector<size_t> group{ i };
+        for (size_t j = i + 1; j < m_Meshes.size(); j++)
+        {
+            if (!isMerged[j] && CanBatch(m_Meshes[j]) && pFirst->HasSameMaterial(m_Meshes[j])) group.push_back(j);
+        }
+        //A single mesh gains nothing from being batched
+        if (group.size() == 1)
+        {
+            meshes.push_back(pFirst);
+            continue;
+        }
+
+        StaticBatch batch{};
+        for (size_t index : group) batch.Add(m_Meshes[index]);
+        Mesh* pBatch{ batch.CreateMesh(pDevice, false, pFirst->CanSwitchCullMode(), pFirst->GetShaderPath(), pFirst->GetVertexFormat()) };
+        //The merged meshes share the textures, so the ones of the first are handed to the batch
+        pBatch->TakeTextures(pFirst);
+        pBatch->SetStatic(true);
+        meshes.push_back(pBatch);
+
+        for (size_t index : group)
+        {
+            isMerged[index] = true;
+            delete m_Meshes[index];
+        }
+    }
+
+    m_Meshes.swap(meshes);
+    m_IsDirty = true;
+}
+
+bool SceneGraph::CanBatch(const Mesh* pMesh)
+{
+    //The batch is a single opaque instance, its world matrix is the identity and it has no tint
+    if (!pMesh->IsStatic() || pMesh->CanGoTransparant() || pMesh->GetInstances().size() != 1) return false;
+
+    const Elite::RGBColor& tint{ pMesh->GetInstances()[0].Tint };
+    return tint.r == 1.f && tint.g == 1.f && tint.b == 1.f;
+}
+
+bool SceneGraph::IsDirty() const
+{
+    return m_IsDirty || std::any_of(m_Meshes.begin(), m_Meshes.end(), [](const Mesh* pMesh) { return pMesh->IsDirty(); });
+}
+
+void SceneGraph::ClearDirty()
+{
+    m_IsDirty = false;
+    for (Mesh* pMesh : m_Meshes) pMesh->ClearDirty();
+}
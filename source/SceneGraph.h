@@ -12,11 +12,24 @@ public:
 	~SceneGraph();
 
 	void AddMesh(Mesh* pMesh);
+	//Draws pMesh once more with its own world matrix and tint, sharing its geometry, effect and textures
+	//pMesh is added to the scene when it isn't part of it yet
+	uint32_t AddInstance(Mesh* pMesh, const Elite::FMatrix4& world, const Elite::RGBColor& tint = Elite::RGBColor{ 1.f, 1.f, 1.f });
 	std::vector<Mesh*>& GetMeshes();
+	//Merges the static meshes that share a material into one StaticBatch mesh per material, the merged meshes are deleted
+	//Only for meshes drawn once with their own colors, instanced or tinted meshes are left as they are
+	//Call it before rendering or after Renderer::Flush, the renderer can't hold on to the merged meshes
+	void BatchStaticMeshes(ID3D11Device* pDevice);
+	//A mesh was added or one of the meshes changed since the last ClearDirty
+	bool IsDirty() const;
+	void ClearDirty();
 private:
 	static SceneGraph* m_Instance;
 	SceneGraph() {};
 
+	static bool CanBatch(const Mesh* pMesh);
+
 	std::vector<Mesh*> m_Meshes{};
+	bool m_IsDirty{ true };
 };
 
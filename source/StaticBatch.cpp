@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "StaticBatch.h"
+
+void StaticBatch::Add(const std::vector<Mesh::Vertex_Input>& vertices, const std::vector<uint32_t>& indices, const Elite::FMatrix4& world)
+{
+	if (!m_Indices.empty()) m_SubmeshStarts.push_back(uint32_t(m_Indices.size()));
+
+	const Elite::FMatrix4 normalMatrix{ Elite::Transpose(Elite::Inverse(world)) };
+	const uint32_t firstVertex{ uint32_t(m_Vertices.size()) };
+	m_Vertices.reserve(m_Vertices.size() + vertices.size());
+	for (const Mesh::Vertex_Input& vertex : vertices)
+	{
+		Mesh::Vertex_Input transformed{ vertex };
+		transformed.Position = Elite::FPoint3{ world * Elite::FPoint4{ vertex.Position } };
+		//Attributes the source mesh doesn't have are zero and stay zero
+		transformed.Normal = Elite::FVector3{ normalMatrix * Elite::FVector4{ vertex.Normal } };
+		if (Elite::SqrMagnitude(transformed.Normal) > 0.f) Elite::Normalize(transformed.Normal);
+		transformed.Tangent = Elite::FVector3{ world * Elite::FVector4{ vertex.Tangent } };
+		if (Elite::SqrMagnitude(transformed.Tangent) > 0.f) Elite::Normalize(transformed.Tangent);
+		m_Vertices.push_back(transformed);
+	}
+
+	m_Indices.reserve(m_Indices.size() + indices.size());
+	for (uint32_t index : indices) m_Indices.push_back(firstVertex + index);
+}
+
+void StaticBatch::Add(const Mesh* pMesh)
+{
+	//GetVertex returns the rasterizer's space, the batch is built in the space of the vertex buffer like the world matrices
+	std::vector<Mesh::Vertex_Input> vertices(pMesh->GetAmountOfVertices());
+	for (uint32_t i = 0; i < vertices.size(); i++)
+	{
+		Mesh::Vertex_Input vertex{ pMesh->GetVertex(i) };
+		vertex.Tangent *= -1;
+		vertex.Position.z *= -1;
+		vertex.Normal.z *= -1;
+		vertices[i] = vertex;
+	}
+
+	const Mesh::Lod& lod{ pMesh->GetLods()[0] };
+	std::vector<uint32_t> indices(lod.AmountIndices);
+	if (pMesh->GetIndexFormat() == DXGI_FORMAT_R16_UINT) std::copy_n(pMesh->GetIndexBuffer16().begin() + lod.FirstIndex, lod.AmountIndices, indices.begin());
+	else std::copy_n(pMesh->GetIndexBuffer32().begin() + lod.FirstIndex, lod.AmountIndices, indices.begin());
+
+	for (const Mesh::Instance& instance : pMesh->GetInstances()) Add(vertices, indices, instance.World);
+}
+
+bool StaticBatch::IsEmpty() const
+{
+	return m_Indices.empty();
+}
+
+Mesh* StaticBatch::CreateMesh(ID3D11Device* pDevice, bool canGoTransparant, bool canSwitchCullMode, const std::string& shaderPath, const VertexFormat& vertexFormat) const
+{
+	return new Mesh(m_Vertices, m_Indices, pDevice, canGoTransparant, canSwitchCullMode, shaderPath, Elite::FMatrix4::Identity(), vertexFormat, m_SubmeshStarts);
+}
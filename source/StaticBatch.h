@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+//Merges static meshes that share a material into a single mesh, so they cost one Update and one draw instead of one per mesh
+//The vertices are transformed into world space up front, every added mesh becomes a submesh with its own bounds for culling
+class StaticBatch final
+{
+public:
+	//Positions and tangents are transformed by world, normals by its inverse transpose so they stay perpendicular under non uniform scaling
+	void Add(const std::vector<Mesh::Vertex_Input>& vertices, const std::vector<uint32_t>& indices, const Elite::FMatrix4& world);
+	//Adds LOD 0 of pMesh once for every instance, unpacked from its vertex buffer so the source file isn't read again
+	void Add(const Mesh* pMesh);
+	bool IsEmpty() const;
+
+	//The mesh is drawn with an identity world matrix, the textures of the shared material are set on it afterwards
+	Mesh* CreateMesh(ID3D11Device* pDevice, bool canGoTransparant, bool canSwitchCullMode, const std::string& shaderPath, const VertexFormat& vertexFormat = VertexFormat{}) const;
+private:
+	std::vector<Mesh::Vertex_Input> m_Vertices;
+	std::vector<uint32_t> m_Indices;
+	//First index of every added mesh after the first one
+	std::vector<uint32_t> m_SubmeshStarts;
+};
+
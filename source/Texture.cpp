@@ -3,6 +3,7 @@
 #include <SDL_image.h>
 
 Texture::Texture(const std::string& filePath, ID3D11Device* pDevice)
+	: m_Path{ filePath }
 {
 	m_pTexture = IMG_Load(filePath.c_str());
 
@@ -51,8 +52,20 @@ ID3D11ShaderResourceView* Texture::GetTextureResourceView() const
 	return m_pTextureResourceView;
 }
 
+const std::string& Texture::GetPath() const
+{
+	return m_Path;
+}
+
 const Elite::RGBColor Texture::Sample(const Elite::FVector2& uv) const
 {
+	float alpha{};
+	return Sample(uv, alpha);
+}
+
+const Elite::RGBColor Texture::Sample(const Elite::FVector2& uv, float& alpha) const
+{
+	alpha = 0.f;
 	if (uv.x < 0 || uv.x > 1.0f || uv.y < 0 || uv.y > 1.f) return Elite::RGBColor{};
 
 	Elite::FVector2 UV{ uv };
@@ -61,11 +74,12 @@ const Elite::RGBColor Texture::Sample(const Elite::FVector2& uv) const
 
 	Uint32 pixelIndex{ Uint32(UV.x) + Uint32(UV.y) * m_pTexture->w };
 
-	Uint8 r{}, g{}, b{};
+	Uint8 r{}, g{}, b{}, a{};
 	Uint32* pixels = (Uint32*)m_pTexture->pixels;
 	Uint32 pPixel = pixels[pixelIndex];
 
-	SDL_GetRGB(pPixel, m_pTexture->format, &r, &g, &b);
+	SDL_GetRGBA(pPixel, m_pTexture->format, &r, &g, &b, &a);
 
+	alpha = a / 255.f;
 	return Elite::RGBColor{ r / 255.f, g / 255.f, b / 255.f };
 }
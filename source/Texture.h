@@ -15,8 +15,12 @@ public:
 	~Texture();
 
 	ID3D11ShaderResourceView* GetTextureResourceView() const;
+	const std::string& GetPath() const;
 	const Elite::RGBColor Sample(const Elite::FVector2& uv) const;
+	//Also returns the alpha of the texel, textures without alpha are opaque
+	const Elite::RGBColor Sample(const Elite::FVector2& uv, float& alpha) const;
 private:
+	std::string m_Path;
 	ID3D11Texture2D* m_pTextureGPU = nullptr;
 	SDL_Surface* m_pTexture = nullptr;
 	ID3D11ShaderResourceView* m_pTextureResourceView = nullptr;
@@ -0,0 +1,65 @@
+#include "pch.h"
+#include "TiledBuffer.h"
+#include <new>
+
+TiledBuffer::TiledBuffer(uint32_t width, uint32_t height, size_t pixelSize, bool useLargePages)
+	: m_AmountOfBlocksX{ (width + BlockSize - 1) / BlockSize }
+	, m_AmountOfBlocksY{ (height + BlockSize - 1) / BlockSize }
+	, m_PixelSize{ pixelSize }
+	, m_Size{ size_t(m_AmountOfBlocksX) * size_t(m_AmountOfBlocksY) * BlockSize * BlockSize * pixelSize }
+	, m_pData{ nullptr }
+	, m_IsLargePage{ false }
+{
+	if (useLargePages)
+	{
+		//Needs the lock pages in memory privilege, large pages are always aligned to a cache line
+		const size_t largePageSize{ GetLargePageMinimum() };
+		if (largePageSize > 0)
+		{
+			const size_t size{ (m_Size + largePageSize - 1) / largePageSize * largePageSize };
+			m_pData = static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+		}
+		m_IsLargePage = m_pData != nullptr;
+		if (!m_IsLargePage) std::cout << "Large pages not available, falling back to regular pages" << '\n';
+	}
+	if (!m_pData) m_pData = static_cast<uint8_t*>(::operator new(m_Size, std::align_val_t{ m_CacheLineSize }));
+	std::fill_n(m_pData, m_Size, uint8_t(0));
+}
+
+TiledBuffer::~TiledBuffer()
+{
+	if (m_IsLargePage) VirtualFree(m_pData, 0, MEM_RELEASE);
+	else ::operator delete(m_pData, std::align_val_t{ m_CacheLineSize });
+}
+
+bool TiledBuffer::IsLargePage() const
+{
+	return m_IsLargePage;
+}
+
+void TiledBuffer::Copy(const TiledBuffer& source, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	const uint32_t blockMinX{ x / BlockSize };
+	const uint32_t blockMaxX{ (x + width + BlockSize - 1) / BlockSize };
+	const uint32_t blockMaxY{ (y + height + BlockSize - 1) / BlockSize };
+	const size_t blockBytes{ BlockSize * BlockSize * m_PixelSize };
+	for (uint32_t blockY = y / BlockSize; blockY < blockMaxY; blockY++)
+	{
+		const size_t offset{ (size_t(blockY) * m_AmountOfBlocksX + blockMinX) * blockBytes };
+		std::copy_n(source.m_pData + offset, (blockMaxX - blockMinX) * blockBytes, m_pData + offset);
+	}
+}
+
+void TiledBuffer::Detile(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t* pDestination, int pitch) const
+{
+	const uint32_t* pData{ GetData<uint32_t>() };
+	for (uint32_t r = y; r < y + height; ++r)
+	{
+		uint32_t* pRow{ reinterpret_cast<uint32_t*>(pDestination + size_t(r) * pitch) };
+		//One row of a block at a time, the last block of the row can stick out of the image
+		for (uint32_t c = x; c < x + width; c += BlockSize)
+		{
+			std::copy_n(pData + GetIndex(c, r), std::min(BlockSize, x + width - c), pRow + c);
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+//Pixel storage of the software rasterizer, pixels are stored in blocks of 8x8 and the blocks row after row
+//A block of 32-bit pixels is 256 bytes, 4 cache lines, so a small triangle touches a few cache lines instead of many strided rows
+//Buffers of the same size share the layout, so one GetIndex addresses all of them
+class TiledBuffer final
+{
+public:
+	static const uint32_t BlockSize{ 8 };
+
+	//The width and height are padded to whole blocks, the allocation is aligned to a cache line and starts out zeroed
+	//With useLargePages the memory is backed by large pages when the process may lock them, otherwise it falls back to regular pages
+	TiledBuffer(uint32_t width, uint32_t height, size_t pixelSize, bool useLargePages = false);
+	~TiledBuffer();
+
+	TiledBuffer(const TiledBuffer&) = delete;
+	TiledBuffer(TiledBuffer&&) noexcept = delete;
+	TiledBuffer& operator=(const TiledBuffer&) = delete;
+	TiledBuffer& operator=(TiledBuffer&&) noexcept = delete;
+
+	size_t GetIndex(uint32_t x, uint32_t y) const
+	{
+		const size_t block{ size_t(y / BlockSize) * m_AmountOfBlocksX + x / BlockSize };
+		return block * BlockSize * BlockSize + (y % BlockSize) * BlockSize + x % BlockSize;
+	}
+	template<typename PixelType>
+	PixelType* GetData() const
+	{
+		return reinterpret_cast<PixelType*>(m_pData);
+	}
+	bool IsLargePage() const;
+
+	//Fills every block the rectangle touches, x and y are multiples of BlockSize
+	template<typename PixelType>
+	void Fill(uint32_t x, uint32_t y, uint32_t width, uint32_t height, PixelType value);
+	//Copies every block the rectangle touches from a buffer of the same size and pixel size, x and y are multiples of BlockSize
+	void Copy(const TiledBuffer& source, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+	//Copies a rectangle of 32-bit pixels into a row major image, pitch is in bytes, x is a multiple of BlockSize
+	void Detile(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t* pDestination, int pitch) const;
+private:
+	static const size_t m_CacheLineSize{ 64 };
+
+	uint32_t m_AmountOfBlocksX;
+	uint32_t m_AmountOfBlocksY;
+	size_t m_PixelSize;
+	size_t m_Size;
+	uint8_t* m_pData;
+	bool m_IsLargePage;
+};
+
+template<typename PixelType>
+void TiledBuffer::Fill(uint32_t x, uint32_t y, uint32_t width, uint32_t height, PixelType value)
+{
+	//The blocks of a block row are next to each other, so every block row of the rectangle is one contiguous range
+	const uint32_t blockMinX{ x / BlockSize };
+	const uint32_t blockMaxX{ (x + width + BlockSize - 1) / BlockSize };
+	const uint32_t blockMaxY{ (y + height + BlockSize - 1) / BlockSize };
+	const size_t blockPixels{ BlockSize * BlockSize };
+	PixelType* pData{ GetData<PixelType>() };
+	for (uint32_t blockY = y / BlockSize; blockY < blockMaxY; blockY++)
+	{
+		std::fill_n(pData + (size_t(blockY) * m_AmountOfBlocksX + blockMinX) * blockPixels, (blockMaxX - blockMinX) * blockPixels, value);
+	}
+}
+
@@ -2,8 +2,8 @@
 #include "TransparantEffect.h"
 #include <sstream>
 
-TransparantEffect::TransparantEffect(ID3D11Device* pDevice, const std::string& shaderPath)
-	: BaseEffect{pDevice, shaderPath}
+TransparantEffect::TransparantEffect(ID3D11Device* pDevice, const std::string& shaderPath, const D3D_SHADER_MACRO* pDefines)
+	: BaseEffect{pDevice, shaderPath, pDefines}
 {
 	m_pDiffuseMapVariable = m_pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource();
 	if (!m_pDiffuseMapVariable->IsValid())
@@ -30,6 +30,22 @@ bool TransparantEffect::ToggleTransparancy()
 	return m_IsTransparent;
 }
 
+bool TransparantEffect::IsTransparent() const
+{
+	return m_IsTransparent;
+}
+
+bool TransparantEffect::ToggleOrderIndependence()
+{
+	m_IsOrderIndependent = !m_IsOrderIndependent;
+	return m_IsOrderIndependent;
+}
+
+bool TransparantEffect::IsOrderIndependent() const
+{
+	return m_IsOrderIndependent;
+}
+
 const std::string TransparantEffect::GetTechniqueName() const
 {
 	std::stringstream ss{};
@@ -4,14 +4,19 @@
 class TransparantEffect : public BaseEffect
 {
 public:
-	TransparantEffect(ID3D11Device* pDevice, const std::string& shaderPath);
+	TransparantEffect(ID3D11Device* pDevice, const std::string& shaderPath, const D3D_SHADER_MACRO* pDefines = nullptr);
 	virtual ~TransparantEffect();
 
 	void SetDiffuseMap(ID3D11ShaderResourceView* pResource);
 	bool ToggleTransparancy();
+	bool IsTransparent() const;
+	//Only used by the software rasterizer, see Mesh::ToggleOrderIndependence
+	bool ToggleOrderIndependence();
+	bool IsOrderIndependent() const;
 private:
 	ID3DX11EffectShaderResourceVariable* m_pDiffuseMapVariable = nullptr;
 	virtual const std::string GetTechniqueName() const override;
 	bool m_IsTransparent = true;
+	bool m_IsOrderIndependent = false;
 };
 
@@ -76,34 +76,18 @@ bool Triangle::Hit(const Elite::FPoint2& screenSpacePixel, float screenWidth, fl
 	//Interpolate values
 	vertex.position.x = screenSpacePixel.x;
 	vertex.position.y = screenSpacePixel.y;
-	vertex.position.z = 1 / ((1 / m_ProjectedVertices[0].z) * weight0 + (1 / m_ProjectedVertices[1].z) * weight1 + (1 / m_ProjectedVertices[2].z) * weight2);
+	//Depth after the divide by w is linear in screen space, every depth format compares the same interpolated value
+	vertex.position.z = m_ProjectedVertices[0].z * weight0 + m_ProjectedVertices[1].z * weight1 + m_ProjectedVertices[2].z * weight2;
 	vertex.position.w = 1 / ((1 / m_ProjectedVertices[0].w) * weight0 + (1 / m_ProjectedVertices[1].w) * weight1 + (1 / m_ProjectedVertices[2].w) * weight2);
 
 	return true;
 }
 
-void Triangle::UpdateProjectionSpace(const Elite::FMatrix4& worldViewProj)
+void Triangle::SetProjectedVertices(const Elite::FPoint4& v0, const Elite::FPoint4& v1, const Elite::FPoint4& v2)
 {
-	for (size_t i = 0; i < m_AmountOfVertices; i++)
-	{
-		m_ProjectedVertices[i] = worldViewProj * Elite::FPoint4{ m_InputVertices[i].Position };
-		m_ProjectedVertices[i].x /= m_ProjectedVertices[i].w;
-		m_ProjectedVertices[i].y /= m_ProjectedVertices[i].w;
-		m_ProjectedVertices[i].z /= m_ProjectedVertices[i].w;
-	}
-}
-
-bool Triangle::IsFrustumCulled(const Camera* pCamera) const
-{
-	//x y
-	//z in world space = w
-	for (size_t i = 0; i < m_AmountOfVertices; i++)
-	{
-		float x{ m_ProjectedVertices[i].x }, y{ m_ProjectedVertices[i].y }, w{ m_ProjectedVertices[i].w };
-		if (x < -1 || x > 1 || y < -1 || y > 1 || pCamera->FrustumCull(w)) return true;
-	}
-
-	return false;
+	m_ProjectedVertices[0] = v0;
+	m_ProjectedVertices[1] = v1;
+	m_ProjectedVertices[2] = v2;
 }
 
 void Triangle::GetBoundingBox(Elite::FPoint2& topLeft, Elite::FPoint2& bottomRight, float screenWidth, float screenHeight) const
@@ -132,7 +116,7 @@ void Triangle::GetBoundingBox(Elite::FPoint2& topLeft, Elite::FPoint2& bottomRig
 
 }
 
-void Triangle::Interpolate(const Elite::FMatrix4& world, VertexOut& vertex, float weight0, float weight1, float weight2) const
+void Triangle::Interpolate(const Elite::FMatrix4& world, const VertexFormat& format, VertexOut& vertex, float weight0, float weight1, float weight2) const
 {
 	//World position
 	//In vector because there's no float * FPoint operation
@@ -144,40 +128,51 @@ void Triangle::Interpolate(const Elite::FMatrix4& world, VertexOut& vertex, floa
 	vertex.worldPosition = Elite::FPoint3{ weight0 * worldPositions[0] + weight1 * worldPositions[1] + weight2 * worldPositions[2] };
 
 	//UV
-	vertex.uv = (m_InputVertices[0].UV / m_ProjectedVertices[0].w) * weight0 + 
-		(m_InputVertices[1].UV / m_ProjectedVertices[1].w) * weight1 + 
-		(m_InputVertices[2].UV / m_ProjectedVertices[2].w) * weight2;
-	vertex.uv *= vertex.position.w;
-
-	//Preparation for normal and tangent
-	Elite::FVector3 worldNormals[m_AmountOfVertices]{};
-	for (size_t i = 0; i < m_AmountOfVertices; i++)
+	if (format.Has(VertexFormat::UV))
 	{
-		worldNormals[i] = Elite::FVector3{ world * Elite::FVector4{m_InputVertices[i].Normal} };
+		vertex.uv = (m_InputVertices[0].UV / m_ProjectedVertices[0].w) * weight0 + 
+			(m_InputVertices[1].UV / m_ProjectedVertices[1].w) * weight1 + 
+			(m_InputVertices[2].UV / m_ProjectedVertices[2].w) * weight2;
+		vertex.uv *= vertex.position.w;
 	}
-	Elite::FVector3 worldTangents[m_AmountOfVertices]{};
-	for (size_t i = 0; i < m_AmountOfVertices; i++)
+
+	//Normal
+	if (format.Has(VertexFormat::Normal))
 	{
-		worldTangents[i] = Elite::FVector3{ world * Elite::FVector4{m_InputVertices[i].Tangent} };
+		Elite::FVector3 worldNormals[m_AmountOfVertices]{};
+		for (size_t i = 0; i < m_AmountOfVertices; i++)
+		{
+			worldNormals[i] = Elite::FVector3{ world * Elite::FVector4{m_InputVertices[i].Normal} };
+		}
+		vertex.normal = (worldNormals[0] / m_ProjectedVertices[0].w) * weight0 + 
+			(worldNormals[1] / m_ProjectedVertices[1].w) * weight1 + 
+			(worldNormals[2] / m_ProjectedVertices[2].w) * weight2;
+		vertex.normal *= vertex.position.w;
+		Elite::Normalize(vertex.normal);
 	}
 
-	//Normal
-	vertex.normal = (worldNormals[0] / m_ProjectedVertices[0].w) * weight0 + 
-		(worldNormals[1] / m_ProjectedVertices[1].w) * weight1 + 
-		(worldNormals[2] / m_ProjectedVertices[2].w) * weight2;
-	vertex.normal *= vertex.position.w;
-	Elite::Normalize(vertex.normal);
 	//Tangent
-	vertex.tangent = (worldTangents[0] / m_ProjectedVertices[0].w) * weight0 + 
-		(worldTangents[1] / m_ProjectedVertices[1].w) * weight1 + 
-		(worldTangents[2] / m_ProjectedVertices[2].w) * weight2;
-	vertex.tangent *= vertex.position.w;
-	Elite::Normalize(vertex.tangent);
+	if (format.Has(VertexFormat::Tangent))
+	{
+		Elite::FVector3 worldTangents[m_AmountOfVertices]{};
+		for (size_t i = 0; i < m_AmountOfVertices; i++)
+		{
+			worldTangents[i] = Elite::FVector3{ world * Elite::FVector4{m_InputVertices[i].Tangent} };
+		}
+		vertex.tangent = (worldTangents[0] / m_ProjectedVertices[0].w) * weight0 + 
+			(worldTangents[1] / m_ProjectedVertices[1].w) * weight1 + 
+			(worldTangents[2] / m_ProjectedVertices[2].w) * weight2;
+		vertex.tangent *= vertex.position.w;
+		Elite::Normalize(vertex.tangent);
+	}
 
 	//Color
-	Elite::RGBColor color{ (m_InputVertices[0].Color / m_ProjectedVertices[0].w) * weight0 + 
-		(m_InputVertices[1].Color / m_ProjectedVertices[1].w) * weight1 + 
-		(m_InputVertices[2].Color / m_ProjectedVertices[2].w) * weight2 };
-	color *= vertex.position.w;
-	vertex.color = color;
+	if (format.Has(VertexFormat::Color))
+	{
+		Elite::RGBColor color{ (m_InputVertices[0].Color / m_ProjectedVertices[0].w) * weight0 + 
+			(m_InputVertices[1].Color / m_ProjectedVertices[1].w) * weight1 + 
+			(m_InputVertices[2].Color / m_ProjectedVertices[2].w) * weight2 };
+		color *= vertex.position.w;
+		vertex.color = color;
+	}
 }
@@ -21,10 +21,11 @@ public:
 	const Elite::FVector3 GetTriangleNormal(const Elite::FMatrix4& world) const;
 	const Elite::FPoint3 GetTriangleMiddle(const Elite::FMatrix4& world) const;
 	bool Hit(const Elite::FPoint2& screenSpacePixel, float screenWidth, float screenHeight, bool frontFaceCulling, VertexOut& vertex, float& weight0, float& weight1, float& weight2) const;
-	void UpdateProjectionSpace(const Elite::FMatrix4& worldViewProj);
-	bool IsFrustumCulled(const Camera* pCamera) const;
+	//The projected vertices come from the renderer's transform pass, which transforms every vertex of the mesh once
+	void SetProjectedVertices(const Elite::FPoint4& v0, const Elite::FPoint4& v1, const Elite::FPoint4& v2);
 	void GetBoundingBox(Elite::FPoint2& topLeft, Elite::FPoint2& bottomRight, float screenWidth, float screenHeight) const;
-	void Interpolate(const Elite::FMatrix4& world, VertexOut& vertex, float weight0, float weight1, float weight2) const;
+	//Only interpolates the attributes the mesh has, the others keep their default value
+	void Interpolate(const Elite::FMatrix4& world, const VertexFormat& format, VertexOut& vertex, float weight0, float weight1, float weight2) const;
 private:
 	static const size_t m_AmountOfVertices{ 3 };
 	Mesh::Vertex_Input m_InputVertices[m_AmountOfVertices];
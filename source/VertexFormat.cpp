@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "VertexFormat.h"
+
+VertexFormat::VertexFormat(uint32_t attributes, bool isCompact)
+	: m_Attributes{ (attributes & All) | Position }
+	, m_IsCompact{ isCompact }
+{
+	for (int i = 0; i < m_AmountOfAttributes; i++)
+	{
+		if (!(m_Attributes & (1u << i))) continue;
+
+		m_Offsets[i] = m_Stride;
+		m_Stride += GetSize(i, m_IsCompact);
+	}
+}
+
+bool VertexFormat::Has(Attribute attribute) const
+{
+	return (m_Attributes & attribute) != 0;
+}
+
+uint32_t VertexFormat::GetAttributes() const
+{
+	return m_Attributes;
+}
+
+bool VertexFormat::IsCompact() const
+{
+	return m_IsCompact;
+}
+
+uint32_t VertexFormat::GetStride() const
+{
+	return m_Stride;
+}
+
+uint32_t VertexFormat::GetOffset(Attribute attribute) const
+{
+	for (int i = 0; i < m_AmountOfAttributes; i++)
+	{
+		if (attribute == (1u << i)) return m_Offsets[i];
+	}
+	return 0;
+}
+
+std::vector<D3D11_INPUT_ELEMENT_DESC> VertexFormat::GetInputElements() const
+{
+	static const char* const semanticNames[m_AmountOfAttributes]{ "POSITION", "COLOR", "TEXCOORD", "NORMAL", "TANGENT" };
+
+	std::vector<D3D11_INPUT_ELEMENT_DESC> elements{};
+	for (int i = 0; i < m_AmountOfAttributes; i++)
+	{
+		if (!(m_Attributes & (1u << i))) continue;
+
+		D3D11_INPUT_ELEMENT_DESC element{};
+		element.SemanticName = semanticNames[i];
+		element.Format = GetFormat(i, m_IsCompact);
+		element.AlignedByteOffset = m_Offsets[i];
+		element.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+		elements.push_back(element);
+	}
+
+	//Per instance data from slot 1: the four rows of the world matrix followed by the tint, see Mesh::Instance
+	for (uint32_t row = 0; row < 5; row++)
+	{
+		D3D11_INPUT_ELEMENT_DESC element{};
+		element.SemanticName = row < 4 ? "WORLD" : "TINT";
+		element.SemanticIndex = row < 4 ? row : 0;
+		element.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		element.InputSlot = 1;
+		element.AlignedByteOffset = row * 4 * sizeof(float);
+		element.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		element.InstanceDataStepRate = 1;
+		elements.push_back(element);
+	}
+	return elements;
+}
+
+std::vector<D3D_SHADER_MACRO> VertexFormat::GetShaderDefines() const
+{
+	static const char* const attributeDefines[m_AmountOfAttributes]{ "VERTEX_POSITION", "VERTEX_COLOR", "VERTEX_UV", "VERTEX_NORMAL", "VERTEX_TANGENT" };
+
+	std::vector<D3D_SHADER_MACRO> defines{};
+	for (int i = 0; i < m_AmountOfAttributes; i++)
+	{
+		if (m_Attributes & (1u << i)) defines.push_back({ attributeDefines[i], "1" });
+	}
+	if (m_IsCompact) defines.push_back({ "COMPACT_VERTEX", "1" });
+	defines.push_back({ nullptr, nullptr });
+	return defines;
+}
+
+uint32_t VertexFormat::GetSize(int attributeIndex, bool isCompact)
+{
+	//Position, Color, UV, Normal, Tangent
+	static const uint32_t sizes[m_AmountOfAttributes]{ 12, 12, 8, 12, 12 };
+	//Position is padded to 4 components, normal and tangent are 2 octahedral components
+	static const uint32_t compactSizes[m_AmountOfAttributes]{ 8, 4, 4, 4, 4 };
+	return isCompact ? compactSizes[attributeIndex] : sizes[attributeIndex];
+}
+
+DXGI_FORMAT VertexFormat::GetFormat(int attributeIndex, bool isCompact)
+{
+	static const DXGI_FORMAT formats[m_AmountOfAttributes]{ DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32_FLOAT,
+		DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT };
+	static const DXGI_FORMAT compactFormats[m_AmountOfAttributes]{ DXGI_FORMAT_R16G16B16A16_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R16G16_UNORM,
+		DXGI_FORMAT_R16G16_SNORM, DXGI_FORMAT_R16G16_SNORM };
+	return isCompact ? compactFormats[attributeIndex] : formats[attributeIndex];
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "pch.h"
+#include <vector>
+
+//Describes which attributes a mesh stores per vertex and how they are packed
+//Attributes are packed in the order of the Attribute enum, attributes a mesh does not have take no space at all
+class VertexFormat final
+{
+public:
+	enum Attribute : uint32_t
+	{
+		Position = 1 << 0,
+		Color = 1 << 1,
+		UV = 1 << 2,
+		Normal = 1 << 3,
+		Tangent = 1 << 4,
+		All = Position | Color | UV | Normal | Tangent
+	};
+
+	//The position is always stored
+	//Compact quantizes every attribute: 16-bit UNORM positions and uvs relative to the bounds of the mesh,
+	//8-bit UNORM colors and octahedral encoded 16-bit SNORM normals and tangents
+	explicit VertexFormat(uint32_t attributes = All, bool isCompact = false);
+
+	bool Has(Attribute attribute) const;
+	uint32_t GetAttributes() const;
+	bool IsCompact() const;
+	uint32_t GetStride() const;
+	uint32_t GetOffset(Attribute attribute) const;
+
+	//Vertices are read from slot 0, the per instance world matrix and tint from slot 1
+	std::vector<D3D11_INPUT_ELEMENT_DESC> GetInputElements() const;
+	//Null terminated, the shaders only read the attributes that are defined (VERTEX_COLOR, VERTEX_UV, ...)
+	std::vector<D3D_SHADER_MACRO> GetShaderDefines() const;
+private:
+	static const int m_AmountOfAttributes{ 5 };
+
+	uint32_t m_Attributes;
+	bool m_IsCompact;
+	uint32_t m_Stride = 0;
+	uint32_t m_Offsets[m_AmountOfAttributes]{};
+
+	static uint32_t GetSize(int attributeIndex, bool isCompact);
+	static DXGI_FORMAT GetFormat(int attributeIndex, bool isCompact);
+};
+
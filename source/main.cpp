@@ -29,8 +29,12 @@ void PrintControls()
 	std::cout << "---Key bindings---" << '\n';
 	std::cout << "R: swap between DirectX and Software Rasterizer" << '\n';
 	std::cout << "F: toggle between texture sampling states (DirectX only)" << '\n';
-	std::cout << "T: toggle transparacny on/off (DirectX only)" << '\n';
+	std::cout << "T: toggle transparacny on/off" << '\n';
+	std::cout << "O: toggle order independent transparency (Software Rasterizer only)" << '\n';
 	std::cout << "C: toggle betwwen cull modes, BackFace - FrontFace - None" << '\n';
+	std::cout << "I: toggle only drawing changed frames, sleeps while idle" << '\n';
+	std::cout << "P: toggle temporal reprojection, reuses shading of the previous frame (Software Rasterizer only)" << '\n';
+	std::cout << "V: toggle variable rate shading, coarser shading away from the middle and far away (Software Rasterizer only)" << '\n';
 }
 
 int main(int argc, char* args[])
@@ -67,20 +71,39 @@ int main(int argc, char* args[])
 	std::vector<uint32_t> indices{};
 	Elite::FMatrix4 translation{ Elite::MakeTranslation(Elite::FVector3{0.f,0.f,40.f}) };
 	std::cout << "Now loading vehicle.obj, Please wait\n";
-	MeshReader::ReadObjFile("Resources/vehicle.obj", vertices, indices);
-	Mesh* pVehicle = new Mesh(vertices, indices, pDevice, false, true, "Resources/PosCol3D.fx", translation);
+	//The obj files have no vertex colors
+	const VertexFormat vehicleFormat{ VertexFormat::Position | VertexFormat::UV | VertexFormat::Normal | VertexFormat::Tangent };
+	//Opaque, so its triangles can be reordered for the vertex cache and overdraw
+	MeshReader::ReadObjFile("Resources/vehicle.obj", vertices, indices, vehicleFormat, true);
+	Mesh* pVehicle = new Mesh(vertices, indices, pDevice, false, true, "Resources/PosCol3D.fx", translation, vehicleFormat);
 	pVehicle->SetDiffuseMap("Resources/vehicle_diffuse.png", pDevice);
 	pVehicle->SetNormalMap("Resources/vehicle_normal.png", pDevice);
 	pVehicle->SetGlossinessMap("Resources/vehicle_gloss.png", pDevice);
 	pVehicle->SetSpecularMap("Resources/vehicle_specular.png", pDevice);
+	//Never moves, the software rasterizer only draws it again when the camera moves
+	pVehicle->SetStatic(true);
 	SceneGraph::GetInstance()->AddMesh(pVehicle);
 
+	//A second parked vehicle, same material, so both are merged into one static batch below
+	Mesh* pParkedVehicle = new Mesh(vertices, indices, pDevice, false, true, "Resources/PosCol3D.fx", Elite::MakeTranslation(Elite::FVector3{ 45.f, 0.f, 80.f }), vehicleFormat);
+	pParkedVehicle->SetDiffuseMap("Resources/vehicle_diffuse.png", pDevice);
+	pParkedVehicle->SetNormalMap("Resources/vehicle_normal.png", pDevice);
+	pParkedVehicle->SetGlossinessMap("Resources/vehicle_gloss.png", pDevice);
+	pParkedVehicle->SetSpecularMap("Resources/vehicle_specular.png", pDevice);
+	pParkedVehicle->SetStatic(true);
+	SceneGraph::GetInstance()->AddMesh(pParkedVehicle);
+
 	std::vector<Mesh::Vertex_Input> exhaustVertices{};
 	std::vector<uint32_t> exhaustIndices{};
-	MeshReader::ReadObjFile("Resources/fireFX.obj", exhaustVertices, exhaustIndices);
-	Mesh* pExhaust = new Mesh(exhaustVertices, exhaustIndices, pDevice, true, false, "Resources/TransparantShading.fx", translation);
+	//The exhaust is unlit on both rasterizers, it only needs its uvs
+	const VertexFormat exhaustFormat{ VertexFormat::Position | VertexFormat::UV };
+	//Blended in index order, so it keeps the triangle order of the file
+	MeshReader::ReadObjFile("Resources/fireFX.obj", exhaustVertices, exhaustIndices, exhaustFormat, false);
+	Mesh* pExhaust = new Mesh(exhaustVertices, exhaustIndices, pDevice, true, false, "Resources/TransparantShading.fx", translation, exhaustFormat);
 	pExhaust->SetDiffuseMap("Resources/fireFX_diffuse.png", pDevice);
 	SceneGraph::GetInstance()->AddMesh(pExhaust);
+	//One Update and one draw for the vehicles instead of one per vehicle
+	SceneGraph::GetInstance()->BatchStaticMeshes(pDevice);
 
 	//Start loop
 	pTimer->Start();
@@ -98,6 +121,9 @@ int main(int argc, char* args[])
 			case SDL_QUIT:
 				isLooping = false;
 				break;
+			case SDL_WINDOWEVENT:
+				if (e.window.event == SDL_WINDOWEVENT_EXPOSED) pRenderer->Invalidate();
+				break;
 			case SDL_KEYUP:
 				switch (e.key.keysym.scancode)
 				{
@@ -153,6 +179,26 @@ int main(int argc, char* args[])
 						}
 					}
 					break;
+				case SDL_SCANCODE_I:
+					std::cout << "Only drawing changed frames: " << (pRenderer->ToggleEventDriven() ? "On" : "Off") << '\n';
+					break;
+				case SDL_SCANCODE_P:
+					std::cout << "Temporal reprojection: " << (pRenderer->ToggleTemporalReprojection() ? "On" : "Off") << '\n';
+					break;
+				case SDL_SCANCODE_V:
+					std::cout << "Variable rate shading: " << (pRenderer->ToggleVariableRateShading() ? "On" : "Off") << '\n';
+					break;
+				case SDL_SCANCODE_O:
+					{
+						std::vector<Mesh*>& meshes{ SceneGraph::GetInstance()->GetMeshes() };
+						bool isOrderIndependent{};
+						for (Mesh* pMesh : meshes)
+						{
+							if (pMesh->CanGoTransparant()) isOrderIndependent = pMesh->ToggleOrderIndependence();
+						}
+						std::cout << "Order independent transparency: " << (isOrderIndependent ? "On" : "Off") << '\n';
+					}
+					break;
 				case SDL_SCANCODE_T:
 					std::vector<Mesh*>& meshes{ SceneGraph::GetInstance()->GetMeshes() };
 					bool isTransparant{};
@@ -170,7 +216,7 @@ int main(int argc, char* args[])
 		pCamera->Move(pTimer->GetElapsed());
 
 		//--------- Render ---------
-		pRenderer->Render(pCamera);
+		const bool hasRendered{ pRenderer->Render(pCamera) };
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -181,8 +227,19 @@ int main(int argc, char* args[])
 			std::cout << "FPS: " << pTimer->GetFPS() << std::endl;
 		}
 
+		//Nothing changed, sleeps until the next event instead of drawing the same frame again
+		//The timer is stopped meanwhile, so the camera doesn't jump by the time spent sleeping
+		if (!hasRendered)
+		{
+			pTimer->Stop();
+			SDL_WaitEvent(nullptr);
+			pTimer->Start();
+		}
+
 	}
 	pTimer->Stop();
+	//The geometry thread may still be reading the meshes
+	pRenderer->Flush();
 
 	//Shutdown "framework"
 	ShutDown(pWindow);